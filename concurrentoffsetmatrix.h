@@ -0,0 +1,430 @@
+#ifndef CONCURRENTOFFSETMATRIX_H
+#define CONCURRENTOFFSETMATRIX_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "offsetmatrix.h"
+
+namespace offset
+{
+
+/* two phase epoch counter for reclaiming memory that lock free readers may
+	still be looking at. readers enter() before touching shared data and
+	exit() after, without ever waiting on a writer. synchronize() returns
+	once every reader that was inside when it was called has left, so
+	anything unlinked before the call can then be freed */
+class Epoch
+{
+private:
+	std::atomic<size_t> epoch;
+	std::atomic<size_t> readers[2];
+
+public:
+	Epoch() : epoch( 0 )
+	{
+		readers[0] = 0;
+		readers[1] = 0;
+	}
+
+	/* returns the epoch to hand back to exit() */
+	size_t enter()
+	{
+		for( ;; )
+		{
+			const size_t e = epoch.load();
+			readers[e & 1].fetch_add( 1 );
+
+			// the epoch moved on before we were counted, count in the new one
+			if( epoch.load() == e ) return e;
+			readers[e & 1].fetch_sub( 1 );
+		}
+	}
+
+	void exit( const size_t e ) { readers[e & 1].fetch_sub( 1 ); }
+
+	/* only one thread at a time, never from inside enter()/exit() */
+	void synchronize()
+	{
+		const size_t e = epoch.load();
+
+		// readers of the previous epoch have normally long gone
+		while( readers[(e +1) & 1].load() != 0 ) std::this_thread::yield();
+		epoch.store( e +1 );
+		while( readers[e & 1].load() != 0 ) std::this_thread::yield();
+	}
+
+	/* enter() and exit() for a scope */
+	class Guard
+	{
+		Epoch &owner;
+		const size_t e;
+
+	public:
+		Guard( Epoch &owner ) : owner( owner ), e( owner.enter() ) {}
+		~Guard() { owner.exit( e ); }
+
+		Guard( const Guard& other ) = delete;
+		Guard& operator=( const Guard& other ) = delete;
+	};
+};
+
+/* OffsetMatrix that many threads can set() and get() at the same time.
+
+	rows live in fixed size segments that never move once created, found
+	through a directory. setting a value in a row takes one of Stripes
+	locks picked by row number, only when a row has to be created in a
+	segment that doesn't exist yet is the directory copied and swapped
+	under an exclusive lock. get() takes no locks at all, it runs inside an
+	Epoch and old rows and directories are freed only once no reader can
+	still see them.
+
+	values are held as std::atomic<T> (T must be trivially copyable), with
+	relaxed loads and stores that are plain moves on common hardware.
+	a value set by one thread is seen by others some time after, there is
+	no ordering between values in different rows */
+template <typename T, size_t Stripes=64>
+class ConcurrentOffsetMatrix
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are stored as std::atomic<T>" );
+
+private:
+	static const size_t segmentRows = 1024;
+	static const size_t retireBatch = 64;  // retired blocks kept before reclaim()
+
+	/* columns [colsMin, colsMin+colsNum) of a row, replaced whole when it grows */
+	struct RowData
+	{
+		size_t colsMin;
+		size_t colsNum;
+		std::unique_ptr< std::atomic<T>[] > values;
+
+		RowData( const size_t colsMin, const size_t colsNum, const T& defaultValue ) :
+			colsMin( colsMin ), colsNum( colsNum ), values( new std::atomic<T>[ colsNum ] )
+		{
+			for( size_t i=0; i<colsNum; ++i )
+				values[i].store( defaultValue, std::memory_order_relaxed );
+		}
+	};
+
+	struct Segment
+	{
+		std::atomic<RowData*> rows[ segmentRows ];
+
+		Segment()
+		{
+			for( std::atomic<RowData*> &r : rows )
+				r.store( nullptr, std::memory_order_relaxed );
+		}
+	};
+
+	/* segments [first, first+size) by segment number (row / segmentRows),
+		entries are nullptr until a row in that segment is set */
+	struct Directory
+	{
+		size_t first;
+		std::vector<Segment*> segments;
+	};
+
+	/* something unlinked that readers may still be using */
+	struct Retired
+	{
+		RowData* row;
+		Directory* directory;
+	};
+
+	T defaultValue;
+
+	mutable Epoch epoch;
+	std::atomic<Directory*> directory;
+
+	// the exclusive section, creates segments and new directories
+	std::mutex growMutex;
+	std::vector< std::unique_ptr<Segment> > owned;
+
+	std::mutex stripes[ Stripes ];
+
+	std::mutex retiredMutex;
+	std::vector<Retired> retired;
+	std::mutex reclaimMutex;
+
+	// range of rows, only changed under rangeMutex so it reads lock free
+	std::mutex rangeMutex;
+	std::atomic<bool> hasRows;
+	std::atomic<size_t> mn, mx;
+
+	/* segment holding row, or nullptr. only inside the epoch */
+	Segment* find_segment( const size_t row ) const;
+
+	/* create the segment for row, growing the directory if needed */
+	Segment* add_segment( const size_t row );
+
+	void retire( RowData* row, Directory* directory );
+
+	/* widen the range of rows after row is created */
+	void extend_rows( const size_t row );
+
+public:
+	ConcurrentOffsetMatrix( const T& defaultValue );
+	~ConcurrentOffsetMatrix();
+
+	ConcurrentOffsetMatrix( const ConcurrentOffsetMatrix& other ) = delete;
+	ConcurrentOffsetMatrix& operator=( const ConcurrentOffsetMatrix& other ) = delete;
+
+	const T& default_value() const { return defaultValue; }
+
+	/* range of rows set so far, min() > max() while empty() */
+	bool empty() const { return !hasRows.load(); }
+	size_t min() const { return mn.load(); }
+	size_t max() const { return mx.load(); }
+
+	/* set the value at row, col from any thread */
+	void set( size_t row, size_t col, const T& val );
+
+	/* returns the value at row, col, if row, col doesn't exist then will
+		return defaultValue. never blocks */
+	T get( size_t row, size_t col ) const;
+	T operator()( size_t row, size_t col ) const { return get( row, col ); }
+
+	/* free the rows and directories replaced so far once no reader can be
+		using them. set() does this every so often by itself */
+	void reclaim();
+
+	/* copy every value that isn't defaultValue into an OffsetMatrix,
+		for example to save() it. values set during the copy may or may
+		not be included */
+	OffsetMatrix<T> to_matrix() const;
+};
+
+template <typename T, size_t Stripes>
+ConcurrentOffsetMatrix<T, Stripes>::ConcurrentOffsetMatrix( const T& defaultValue ) :
+	defaultValue( defaultValue ), directory( new Directory() ), hasRows( false ), mn( 1 ), mx( 0 )
+{
+	directory.load()->first = 0;
+}
+
+template <typename T, size_t Stripes>
+ConcurrentOffsetMatrix<T, Stripes>::~ConcurrentOffsetMatrix()
+{
+	// nothing can be reading any more
+	for( const Retired &r : retired )
+	{
+		delete r.row;
+		delete r.directory;
+	}
+
+	for( const std::unique_ptr<Segment> &s : owned )
+		for( std::atomic<RowData*> &r : s->rows )
+			delete r.load();
+
+	delete directory.load();
+}
+
+template <typename T, size_t Stripes>
+typename ConcurrentOffsetMatrix<T, Stripes>::Segment* ConcurrentOffsetMatrix<T, Stripes>::find_segment( const size_t row ) const
+{
+	const Directory* d = directory.load( std::memory_order_acquire );
+
+	// segment < first wraps around, so one comparison covers both ends
+	const size_t i = row / segmentRows - d->first;
+	return i < d->segments.size() ? d->segments[i] : nullptr;
+}
+
+template <typename T, size_t Stripes>
+typename ConcurrentOffsetMatrix<T, Stripes>::Segment* ConcurrentOffsetMatrix<T, Stripes>::add_segment( const size_t row )
+{
+	std::lock_guard<std::mutex> lock( growMutex );
+
+	// somebody else may have got here first
+	Segment* s = find_segment( row );
+	if( s ) return s;
+
+	owned.emplace_back( new Segment() );
+	s = owned.back().get();
+
+	const size_t seg = row / segmentRows;
+	Directory* old = directory.load();
+
+	/* segment already in range, the directory still has to be copied
+		as readers may be looking at the old one */
+	std::unique_ptr<Directory> d( new Directory() );
+	if( old->segments.empty() )
+	{
+		d->first = seg;
+		d->segments.assign( 1, s );
+	}
+	else
+	{
+		d->first = std::min( old->first, seg );
+		const size_t last = std::max( old->first + old->segments.size() -1, seg );
+
+		d->segments.assign( last - d->first +1, nullptr );
+		std::copy( old->segments.begin(), old->segments.end(), d->segments.begin() + (old->first - d->first) );
+		d->segments[ seg - d->first ] = s;
+	}
+
+	directory.store( d.release(), std::memory_order_release );
+	retire( nullptr, old );
+
+	return s;
+}
+
+template <typename T, size_t Stripes>
+void ConcurrentOffsetMatrix<T, Stripes>::retire( RowData* row, Directory* directory )
+{
+	std::lock_guard<std::mutex> lock( retiredMutex );
+
+	Retired r;
+	r.row = row;
+	r.directory = directory;
+	retired.push_back( r );
+}
+
+template <typename T, size_t Stripes>
+void ConcurrentOffsetMatrix<T, Stripes>::reclaim()
+{
+	std::lock_guard<std::mutex> lock( reclaimMutex );
+
+	std::vector<Retired> batch;
+	{
+		std::lock_guard<std::mutex> lock( retiredMutex );
+		batch.swap( retired );
+	}
+
+	if( batch.empty() ) return;
+
+	// wait out every reader that could have seen the batch
+	epoch.synchronize();
+
+	for( const Retired &r : batch )
+	{
+		delete r.row;
+		delete r.directory;
+	}
+}
+
+template <typename T, size_t Stripes>
+void ConcurrentOffsetMatrix<T, Stripes>::extend_rows( const size_t row )
+{
+	std::lock_guard<std::mutex> lock( rangeMutex );
+
+	if( !hasRows.load() || row < mn.load() ) mn.store( row );
+	if( !hasRows.load() || row > mx.load() ) mx.store( row );
+	hasRows.store( true );
+}
+
+template <typename T, size_t Stripes>
+void ConcurrentOffsetMatrix<T, Stripes>::set( size_t row, size_t col, const T& val )
+{
+	bool reclaimNow = false;
+	{
+		Epoch::Guard guard( epoch );
+
+		Segment* s = find_segment( row );
+		if( !s )
+		{
+			if( val == defaultValue ) return;
+			s = add_segment( row );
+		}
+
+		std::lock_guard<std::mutex> lock( stripes[ row % Stripes ] );
+
+		// only writers holding this stripe change the row pointer
+		std::atomic<RowData*> &slot = s->rows[ row % segmentRows ];
+		RowData* r = slot.load( std::memory_order_relaxed );
+
+		if( !r || col - r->colsMin >= r->colsNum )
+		{
+			if( val == defaultValue ) return;
+
+			RowData* grown;
+			if( !r )
+			{
+				grown = new RowData( col, 1, defaultValue );
+			}
+			else
+			{
+				/* grow towards col by at least the current size so a row
+					filled column by column is copied O(log n) times */
+				size_t lo = r->colsMin, hi = r->colsMin + r->colsNum -1;
+				if( col < lo ) lo = std::min( col, lo - std::min( lo, r->colsNum ) );
+				else hi = std::max( col, hi + r->colsNum );
+
+				grown = new RowData( lo, hi - lo +1, defaultValue );
+				for( size_t i=0; i<r->colsNum; ++i )
+					grown->values[ r->colsMin - lo + i ].store(
+						r->values[i].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+			}
+
+			slot.store( grown, std::memory_order_release );
+			if( r )
+			{
+				retire( r, nullptr );
+			}
+			else
+			{
+				extend_rows( row );
+			}
+			r = grown;
+
+			std::lock_guard<std::mutex> lock( retiredMutex );
+			reclaimNow = retired.size() >= retireBatch;
+		}
+
+		r->values[ col - r->colsMin ].store( val, std::memory_order_relaxed );
+	}
+
+	// outside the epoch, synchronize() would otherwise wait for ourselves
+	if( reclaimNow ) reclaim();
+}
+
+template <typename T, size_t Stripes>
+T ConcurrentOffsetMatrix<T, Stripes>::get( size_t row, size_t col ) const
+{
+	Epoch::Guard guard( epoch );
+
+	const Segment* s = find_segment( row );
+	if( !s ) return defaultValue;
+
+	const RowData* r = s->rows[ row % segmentRows ].load( std::memory_order_acquire );
+	if( !r ) return defaultValue;
+
+	const size_t i = col - r->colsMin;
+	return i < r->colsNum ? r->values[i].load( std::memory_order_relaxed ) : defaultValue;
+}
+
+template <typename T, size_t Stripes>
+OffsetMatrix<T> ConcurrentOffsetMatrix<T, Stripes>::to_matrix() const
+{
+	OffsetMatrix<T> m( defaultValue );
+
+	Epoch::Guard guard( epoch );
+	const Directory* d = directory.load( std::memory_order_acquire );
+
+	for( size_t i=0; i<d->segments.size(); ++i )
+	{
+		const Segment* s = d->segments[i];
+		if( !s ) continue;
+
+		for( size_t j=0; j<segmentRows; ++j )
+		{
+			const RowData* r = s->rows[j].load( std::memory_order_acquire );
+			if( !r ) continue;
+
+			const size_t row = (d->first + i) * segmentRows + j;
+			for( size_t k=0; k<r->colsNum; ++k )
+				m.set( row, r->colsMin + k, r->values[k].load( std::memory_order_relaxed ) );
+		}
+	}
+
+	return m;
+}
+
+}
+
+#endif
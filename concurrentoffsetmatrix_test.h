@@ -0,0 +1,111 @@
+#include <cxxtest/TestSuite.h>
+#include <thread>
+#include "concurrentoffsetmatrix.h"
+
+using namespace offset;
+
+class ConcurrentOffsetMatrixTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_empty()
+	{
+		ConcurrentOffsetMatrix<int> store( defaultValue );
+
+		TS_ASSERT( store.empty() );
+		TS_ASSERT_EQUALS( store.get( 0, 0 ), defaultValue );
+
+		store.set( 5, 5, defaultValue ); // stores nothing
+		TS_ASSERT( store.empty() );
+	}
+
+	void test_set()
+	{
+		ConcurrentOffsetMatrix<int> store( defaultValue );
+
+		// rows in several segments, columns growing both ways
+		store.set( 10, 42, 1 );
+		store.set( 5000, 41, 2 );
+		store.set( 10, 3, 3 );
+		store.set( 10, 100, 4 );
+		store.set( 3, 7, 5 );
+
+		TS_ASSERT( !store.empty() );
+		TS_ASSERT_EQUALS( store.min(), 3 );
+		TS_ASSERT_EQUALS( store.max(), 5000 );
+
+		TS_ASSERT_EQUALS( store.get( 10, 42 ), 1 );
+		TS_ASSERT_EQUALS( store.get( 5000, 41 ), 2 );
+		TS_ASSERT_EQUALS( store.get( 10, 3 ), 3 );
+		TS_ASSERT_EQUALS( store.get( 10, 100 ), 4 );
+		TS_ASSERT_EQUALS( store.get( 3, 7 ), 5 );
+
+		TS_ASSERT_EQUALS( store.get( 10, 50 ), defaultValue );
+		TS_ASSERT_EQUALS( store.get( 11, 42 ), defaultValue );
+		TS_ASSERT_EQUALS( store.get( (size_t)-1, 42 ), defaultValue );
+
+		store.set( 10, 42, defaultValue );
+		TS_ASSERT_EQUALS( store.get( 10, 42 ), defaultValue );
+
+		OffsetMatrix<int> m = store.to_matrix();
+		TS_ASSERT_EQUALS( m.min(), 3 );
+		TS_ASSERT_EQUALS( m.max(), 5000 );
+		TS_ASSERT_EQUALS( m.get( 10, 100 ), 4 );
+		TS_ASSERT_EQUALS( m.count_not_default(), 4 );
+	}
+
+	void test_threads()
+	{
+		const size_t threads = 8, rows = 3000, cols = 40;
+		ConcurrentOffsetMatrix<int> store( defaultValue );
+
+		std::atomic<bool> done( false );
+		std::atomic<size_t> bad( 0 );
+
+		// a reader watching values appear, each is either unset or right
+		std::thread reader( [&]()
+		{
+			while( !done )
+				for( size_t row=0; row<rows; row+=97 )
+					for( size_t col=0; col<cols; ++col )
+					{
+						const int val = store.get( row, col );
+						if( val != defaultValue && val != (int)(row * cols + col) ) ++bad;
+					}
+		} );
+
+		// writers interleaved over the same rows, from both ends
+		std::vector<std::thread> writers;
+		for( size_t t=0; t<threads; ++t )
+			writers.emplace_back( [&, t]()
+			{
+				for( size_t i=0; i<rows; ++i )
+				{
+					const size_t row = t % 2 ? i : rows -1 - i;
+					for( size_t col=t; col<cols; col+=threads )
+						store.set( row, cols -1 - col, (int)(row * cols + cols -1 - col) );
+				}
+			} );
+
+		for( std::thread &w : writers )
+			w.join();
+		done = true;
+		reader.join();
+
+		TS_ASSERT_EQUALS( bad.load(), 0 );
+		TS_ASSERT_EQUALS( store.min(), 0 );
+		TS_ASSERT_EQUALS( store.max(), rows -1 );
+
+		store.reclaim();
+		for( size_t row=0; row<rows; ++row )
+			for( size_t col=0; col<cols; ++col )
+				TS_ASSERT_EQUALS( store.get( row, col ), (int)(row * cols + col) );
+	}
+};
@@ -0,0 +1,120 @@
+#ifndef FROZENOFFSETMATRIX_H
+#define FROZENOFFSETMATRIX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "offsetreduce.h"
+
+namespace offset
+{
+
+/* read only copy of an OffsetMatrix packed into one buffer.
+	the values of every row sit back to back in values, row i starts at
+	rowStart[i] and runs to rowStart[i+1], its first column is colMin[i].
+	that is 16 bytes per row rather than a vector, min and default value
+	each, and a lookup is two array reads into a single allocation.
+	rows are handed out the same way as OffsetMatrixView */
+template <typename T>
+class FrozenOffsetMatrix
+{
+public:
+	/* location of one row inside the buffer */
+	struct RowIndex
+	{
+		size_t colsMin;
+		size_t colsNum;
+		const T* data;
+	};
+
+private:
+	size_t mn = 0;
+	std::vector<T> vals;
+	std::vector<uint64_t> rowStart;  // size() +1 entries
+	std::vector<uint64_t> colMin;
+
+public:
+	T defaultValue = 0;
+
+	FrozenOffsetMatrix( const T& defaultValue=0 ) : defaultValue(defaultValue) {}
+
+	/* pack matrix, any matrix with dense rows (OffsetMatrix<T> or similar) */
+	template <typename Matrix>
+	explicit FrozenOffsetMatrix( const Matrix& matrix );
+
+	/* get the number of rows, the min/max row numbers from the matrix */
+	size_t min() const { return mn; }
+	size_t max() const { return mn + size() -1; }
+	size_t size() const { return colMin.size(); }
+	bool empty() const { return colMin.empty(); }
+	size_t values() const { return vals.size(); }
+
+	/* number of stored values equal to val */
+	size_t count( const T& val ) const { return reduce::count( vals.data(), vals.size(), val ); }
+
+	/* every value stored, row after row */
+	const T* data() const { return vals.data(); }
+
+	/* no bounds checking,
+		only use if row >= min() && row <= max() && !empty() */
+	RowIndex get_row( size_t row ) const;
+
+	/* returns the value at row, col,
+		if row, col doesn't exist then will return defaultValue */
+	T get( size_t row, size_t col ) const;
+	T operator()( size_t row, size_t col ) const { return get( row, col ); }
+};
+
+template <typename T>
+template <typename Matrix>
+FrozenOffsetMatrix<T>::FrozenOffsetMatrix( const Matrix& matrix ) : defaultValue( matrix.defaultValue )
+{
+	if( matrix.empty() ) return;
+
+	mn = matrix.min();
+	vals.reserve( matrix.values() );
+	rowStart.reserve( matrix.size() +1 );
+	colMin.reserve( matrix.size() );
+
+	rowStart.push_back( 0 );
+	for( size_t row=matrix.min(); row<=matrix.max(); ++row )
+	{
+		const auto &r = matrix.get_row( row );
+
+		vals.insert( vals.end(), r.begin(), r.end() );
+		rowStart.push_back( vals.size() );
+		colMin.push_back( r.empty() ? 0 : r.min() );
+	}
+}
+
+template <typename T>
+typename FrozenOffsetMatrix<T>::RowIndex FrozenOffsetMatrix<T>::get_row( size_t row ) const
+{
+	const size_t i = row - mn;
+
+	RowIndex r;
+	r.colsMin = colMin[i];
+	r.colsNum = rowStart[i+1] - rowStart[i];
+	r.data = vals.data() + rowStart[i];
+
+	return r;
+}
+
+template <typename T>
+T FrozenOffsetMatrix<T>::get( size_t row, size_t col ) const
+{
+	// row < min() wraps around, so one comparison covers both ends
+	const size_t i = row - mn;
+	if( i >= size() ) return defaultValue;
+
+	const size_t start = rowStart[i];
+	const size_t offset = col - colMin[i];
+	if( offset >= rowStart[i+1] - start ) return defaultValue;
+
+	return vals[ start + offset ];
+}
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <cxxtest/TestSuite.h>
+#include "offsetmatrix.h"
+#include "frozenoffsetmatrix.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class FrozenOffsetMatrixTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_empty()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		FrozenOffsetMatrix<int> frozen = store.freeze();
+
+		TS_ASSERT( frozen.empty() );
+		TS_ASSERT_EQUALS( frozen.values(), 0 );
+		TS_ASSERT_EQUALS( frozen.get( 0, 0 ), defaultValue );
+	}
+
+	void test_freeze()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		FrozenOffsetMatrix<int> frozen = store.freeze();
+
+		TS_ASSERT_EQUALS( store.min(), frozen.min() );
+		TS_ASSERT_EQUALS( store.max(), frozen.max() );
+		TS_ASSERT_EQUALS( store.size(), frozen.size() );
+		TS_ASSERT_EQUALS( store.values(), frozen.values() );
+		TS_ASSERT_EQUALS( frozen.defaultValue, defaultValue );
+
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( store.get(row, col), frozen.get(row, col) );
+
+		// huge coordinates must not wrap around into a valid row or column
+		TS_ASSERT_EQUALS( frozen.get( (size_t)-1, 15 ), defaultValue );
+		TS_ASSERT_EQUALS( frozen.get( 15, (size_t)-1 ), defaultValue );
+	}
+
+	void test_rows()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+		store.set( 25, 3, 1 ); // leaves rows 20 to 24 empty
+
+		FrozenOffsetMatrix<int> frozen( store );
+
+		FrozenOffsetMatrix<int>::RowIndex r = frozen.get_row( 12 );
+		TS_ASSERT_EQUALS( r.colsMin, 12 );
+		TS_ASSERT_EQUALS( r.colsNum, 12 );
+		TS_ASSERT_EQUALS( r.data[0], 1212 );
+
+		TS_ASSERT_EQUALS( frozen.get_row( 22 ).colsNum, 0 );
+		TS_ASSERT_EQUALS( frozen.get( 22, 0 ), defaultValue );
+		TS_ASSERT_EQUALS( frozen.get( 25, 3 ), 1 );
+
+		// rows are packed back to back
+		TS_ASSERT_EQUALS( frozen.get_row( 11 ).data, frozen.get_row( 10 ).data + 10 );
+		TS_ASSERT_EQUALS( frozen.count( 1 ), 1 );
+
+		// counted a block at a time, the same as the matrix rows
+		for( size_t col=0; col<300; col+=3 )
+			store.set( 25, col, 2 );
+		FrozenOffsetMatrix<int> many( store );
+		TS_ASSERT_EQUALS( many.count( 2 ), 100 );
+		TS_ASSERT_EQUALS( many.count( 2 ), store.count( 2 ) );
+		TS_ASSERT_EQUALS( many.count( defaultValue ), store.count( defaultValue ) );
+	}
+};
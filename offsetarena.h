@@ -0,0 +1,202 @@
+#ifndef OFFSETARENA_H
+#define OFFSETARENA_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace offset
+{
+
+/* monotonic arena. memory is handed out from a few large blocks by bumping
+	a pointer, deallocating single allocations does nothing and everything
+	is given back at once when the arena is released or destroyed.
+
+	suits a matrix built once and then only read, such as one filled by
+	load(), where per row malloc/free and the fragmentation it leaves behind
+	are pure overhead. allocations are serialised with a mutex so rows can
+	be created from several threads */
+class Arena
+{
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t blockSize;
+	size_t pos = 0;         // offset of the next free byte in blocks.back()
+	size_t used = 0;        // bytes handed out so far
+	mutable std::mutex mutex;
+
+	void add_block( const size_t bytes );
+
+public:
+	/* blockSize is the minimum size of each block taken from the system */
+	explicit Arena( const size_t blockSize = 1 << 20 ) : blockSize( std::max( blockSize, (size_t)64 ) ) {}
+
+	Arena( const Arena& other ) = delete;
+	Arena& operator=( const Arena& other ) = delete;
+
+	/* bytes of memory aligned to alignment (a power of two) */
+	void* allocate( const size_t bytes, const size_t alignment );
+
+	/* make sure the next bytes of allocations fit in the current block,
+		call with the total size of the allocations to come (plus their
+		alignment padding) to get them all from one block */
+	void reserve( const size_t bytes );
+
+	/* give back every block, any memory handed out is no longer valid */
+	void release();
+
+	/* bytes handed out and bytes taken from the system */
+	size_t allocated() const;
+	size_t capacity() const;
+
+	/* number of blocks taken from the system */
+	size_t size() const;
+};
+
+inline void Arena::add_block( const size_t bytes )
+{
+	Block block;
+	block.size = std::max( bytes, blockSize );
+	block.data.reset( new char[ block.size ] );
+
+	blocks.push_back( std::move( block ) );
+	pos = 0;
+}
+
+inline void* Arena::allocate( const size_t bytes, const size_t alignment )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	/* aligned position of the allocation in the current block, or nullptr if it won't fit */
+	auto fit = [&]() -> char*
+	{
+		if( blocks.empty() ) return nullptr;
+
+		const Block &b = blocks.back();
+		const uintptr_t base = reinterpret_cast<uintptr_t>( b.data.get() );
+		const uintptr_t start = (base + pos + alignment -1) & ~(uintptr_t)(alignment -1);
+		if( start - base + bytes > b.size ) return nullptr;
+
+		pos = start - base + bytes;
+		return reinterpret_cast<char*>( start );
+	};
+
+	char* p = fit();
+	if( !p )
+	{
+		add_block( bytes + alignment );
+		p = fit();
+	}
+
+	used += bytes;
+	return p;
+}
+
+inline void Arena::reserve( const size_t bytes )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	if( blocks.empty() || blocks.back().size - pos < bytes )
+		add_block( bytes );
+}
+
+inline void Arena::release()
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	blocks.clear();
+	pos = used = 0;
+}
+
+inline size_t Arena::allocated() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return used;
+}
+
+inline size_t Arena::capacity() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+
+	size_t c = 0;
+	for( const Block &b : blocks )
+		c += b.size;
+
+	return c;
+}
+
+inline size_t Arena::size() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return blocks.size();
+}
+
+/* standard allocator handing out memory from an Arena, for example
+
+		Arena arena;
+		OffsetMatrix<int, OffsetVector<int, ArenaAllocator<int>>> m( 0, arena );
+
+	the allocator follows the container on copy, move and swap so rows
+	moved or assigned into an arena backed matrix stay in its arena.
+	a default constructed allocator has no arena and uses new/delete, so
+	containers that default construct their elements still work */
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	Arena* arena = nullptr;
+
+	ArenaAllocator() noexcept {}
+	ArenaAllocator( Arena& arena ) noexcept : arena( &arena ) {}
+
+	template <typename U>
+	ArenaAllocator( const ArenaAllocator<U>& other ) noexcept : arena( other.arena ) {}
+
+	T* allocate( const size_t n )
+	{
+		if( !arena ) return static_cast<T*>( ::operator new( sizeof(T) * n ) );
+
+		return static_cast<T*>( arena->allocate( sizeof(T) * n, alignof(T) ) );
+	}
+
+	void deallocate( T* p, const size_t ) noexcept
+	{
+		if( !arena ) ::operator delete( p );
+	}
+};
+
+template <typename T, typename U>
+bool operator==( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) { return a.arena == b.arena; }
+
+template <typename T, typename U>
+bool operator!=( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) { return a.arena != b.arena; }
+
+/* tell alloc that about bytes of allocations are coming,
+	does nothing unless alloc has something like an arena to size up */
+template <typename Alloc>
+void reserve_allocator( Alloc&, const size_t ) {}
+
+template <typename T>
+void reserve_allocator( ArenaAllocator<T>& alloc, const size_t bytes )
+{
+	if( alloc.arena ) alloc.arena->reserve( bytes );
+}
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include "offsetarena.h"
+#include "offsetmatrix.h"
+#include "offsetsparsevector.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class OffsetArenaTest: public CxxTest::TestSuite
+{
+private:
+	typedef OffsetVector<int, ArenaAllocator<int> > ArenaRow;
+	typedef OffsetMatrix<int, ArenaRow> ArenaMatrix;
+
+	std::string filename;
+
+public:
+	void setUp()
+	{
+		filename = "offsetarena_test.bin";
+	}
+
+	void tearDown()
+	{
+		remove( filename.c_str() );
+	}
+
+	void test_allocate()
+	{
+		Arena arena( 256 );
+
+		char* a = static_cast<char*>( arena.allocate( 10, 1 ) );
+		double* b = static_cast<double*>( arena.allocate( sizeof(double), alignof(double) ) );
+
+		TS_ASSERT_EQUALS( reinterpret_cast<uintptr_t>( b ) % alignof(double), 0 );
+		TS_ASSERT( reinterpret_cast<char*>( b ) >= a + 10 );
+		TS_ASSERT_EQUALS( arena.size(), 1 );
+		TS_ASSERT_EQUALS( arena.allocated(), 10 + sizeof(double) );
+
+		// too big for the current block, gets a block of its own
+		arena.allocate( 1000, 8 );
+		TS_ASSERT_EQUALS( arena.size(), 2 );
+		TS_ASSERT( arena.capacity() >= 256 + 1000 );
+
+		arena.release();
+		TS_ASSERT_EQUALS( arena.size(), 0 );
+		TS_ASSERT_EQUALS( arena.allocated(), 0 );
+	}
+
+	void test_reserve()
+	{
+		Arena arena( 64 );
+		arena.reserve( 4096 );
+
+		for( size_t i=0; i<16; ++i )
+			arena.allocate( 256, 8 );
+
+		TS_ASSERT_EQUALS( arena.size(), 1 );
+	}
+
+	void test_vector()
+	{
+		Arena arena;
+		ArenaRow v( 0, arena );
+
+		for( size_t col=100; col>0; --col )
+			v.set( col, (int)col );
+
+		TS_ASSERT_EQUALS( v.get_allocator(), ArenaAllocator<int>( arena ) );
+		TS_ASSERT_EQUALS( v.size(), 100 );
+		for( size_t col=1; col<=100; ++col )
+			TS_ASSERT_EQUALS( v.get( col ), (int)col );
+
+		TS_ASSERT( arena.allocated() >= sizeof(int) * 100 );
+
+		// a copy stays in the same arena
+		ArenaRow c( v );
+		TS_ASSERT_EQUALS( c.get_allocator(), v.get_allocator() );
+		TS_ASSERT_EQUALS( c.get( 50 ), 50 );
+
+		// without an arena new/delete are used
+		ArenaRow h;
+		h.set( 5, 5 );
+		TS_ASSERT_EQUALS( h.get_allocator().arena, nullptr );
+		TS_ASSERT_EQUALS( h.get( 5 ), 5 );
+	}
+
+	void test_sparse()
+	{
+		Arena arena;
+		OffsetSparseVector<int, 4, ArenaAllocator<int> > v( 0, arena );
+
+		v.set( 10, 1 );
+		v.set( 1000, 2 );
+
+		TS_ASSERT_EQUALS( v.runs().size(), 2 );
+		TS_ASSERT_EQUALS( v.runs().back().get_allocator(), ArenaAllocator<int>( arena ) );
+		TS_ASSERT_EQUALS( v.get( 1000 ), 2 );
+	}
+
+	void test_matrix()
+	{
+		Arena arena;
+		ArenaMatrix store( 999, arena );
+		test::fill( store );
+
+		// rows created at either end all come from the arena
+		store.set( 5, 1, 1 );
+		store.set( 30, 1, 1 );
+		for( size_t row=store.min(); row<=store.max(); ++row )
+			TS_ASSERT_EQUALS( store.get_row( row ).get_allocator(), store.get_allocator() );
+
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 1520 );
+		TS_ASSERT_EQUALS( store.get( 15, 40 ), 999 );
+	}
+
+	void test_load()
+	{
+		OffsetMatrix<int> original( 999 );
+		test::fill( original );
+		TS_ASSERT( !original.save( filename ) );
+
+		Arena arena( 64 );
+		ArenaMatrix store( 999, arena );
+		TS_ASSERT( !store.load( filename ) );
+
+		// load sizes the arena up front so everything lands in one block
+		TS_ASSERT_EQUALS( arena.size(), 1 );
+		TS_ASSERT_EQUALS( store.values(), original.values() );
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( store.get( row, col ), original.get( row, col ) );
+
+		Arena parallel;
+		ArenaMatrix threaded( 999, parallel );
+		LoadOptions options;
+		options.threads = 4;
+		TS_ASSERT( !threaded.load( filename, options ) );
+		TS_ASSERT_EQUALS( parallel.size(), 1 );
+		TS_ASSERT_EQUALS( threaded.get( 19, 37 ), 1937 );
+	}
+};
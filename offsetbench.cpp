@@ -0,0 +1,283 @@
+/* benchmarks for OffsetMatrix, run with make bench.
+
+	every case prints one tab separated line
+		case  type  type_bytes  rows  cols  ops  seconds  ops_per_sec  mb_per_sec
+	after a header line starting with #, so runs can be kept and compared
+	across releases. each matrix shape holds about the same number of
+	values, pass a different number as the first argument to scale them */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "offsetmatrix.h"
+
+using namespace offset;
+
+/* 32 byte value, for the cost of moving bigger T around */
+struct Wide
+{
+	double v[4];
+
+	Wide( double x=0 ) : v{ x, x, x, x } {}
+	bool operator==( const Wide& other ) const { return std::equal( v, v + 4, other.v ); }
+	bool operator!=( const Wide& other ) const { return !(*this == other); }
+};
+
+struct Shape
+{
+	size_t rows;
+	size_t cols;
+};
+
+static const char* benchFile = "offsetbench.bin";
+
+/* results are added to sink so the compiler can't drop the work */
+static volatile size_t sink = 0;
+
+template <typename T> const char* type_name();
+template <> const char* type_name<uint8_t>() { return "uint8"; }
+template <> const char* type_name<int32_t>() { return "int32"; }
+template <> const char* type_name<double>() { return "double"; }
+template <> const char* type_name<Wide>() { return "wide32"; }
+
+template <typename F>
+double time_it( F fn )
+{
+	const auto start = std::chrono::steady_clock::now();
+	fn();
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+template <typename T>
+void report( const std::string& name, const Shape& shape, size_t ops, size_t bytes, double seconds )
+{
+	std::cout << name << "\t" << type_name<T>() << "\t" << sizeof(T) << "\t"
+			  << shape.rows << "\t" << shape.cols << "\t" << ops << "\t" << seconds << "\t"
+			  << (seconds > 0 ? ops / seconds : 0) << "\t"
+			  << (seconds > 0 ? bytes / seconds / (1 << 20) : 0) << "\n";
+}
+
+template <typename T>
+T value_at( size_t row, size_t col ) { return T( (row * 31 + col) % 100 + 1 ); }
+
+template <typename T>
+void fill( OffsetMatrix<T>& store, const Shape& shape )
+{
+	for( size_t row=0; row<shape.rows; ++row )
+		for( size_t col=0; col<shape.cols; ++col )
+			store.set( row, col, value_at<T>( row, col ) );
+}
+
+template <typename T>
+void bench_set( const Shape& shape, std::mt19937& rng )
+{
+	const size_t n = shape.rows * shape.cols;
+	const size_t bytes = sizeof(T) * n;
+
+	{
+		OffsetMatrix<T> store( T(0) );
+		report<T>( "set_sequential", shape, n, bytes, time_it( [&]() { fill( store, shape ); } ) );
+	}
+
+	// every row and every column grows at the front
+	{
+		OffsetMatrix<T> store( T(0) );
+		const double seconds = time_it( [&]()
+		{
+			for( size_t row=shape.rows; row-- > 0; )
+				for( size_t col=shape.cols; col-- > 0; )
+					store.set( row, col, value_at<T>( row, col ) );
+		} );
+		report<T>( "set_reverse", shape, n, bytes, seconds );
+	}
+
+	std::vector<size_t> order( n );
+	std::iota( order.begin(), order.end(), 0 );
+	std::shuffle( order.begin(), order.end(), rng );
+
+	{
+		OffsetMatrix<T> store( T(0) );
+		const double seconds = time_it( [&]()
+		{
+			for( const size_t i : order )
+				store.set( i / shape.cols, i % shape.cols, value_at<T>( i / shape.cols, i % shape.cols ) );
+		} );
+		report<T>( "set_random", shape, n, bytes, seconds );
+	}
+
+	{
+		std::vector<size_t> rows( n ), cols( n );
+		std::vector<T> vals( n );
+		for( size_t k=0; k<n; ++k )
+		{
+			rows[k] = order[k] / shape.cols;
+			cols[k] = order[k] % shape.cols;
+			vals[k] = value_at<T>( rows[k], cols[k] );
+		}
+
+		OffsetMatrix<T> store( T(0) );
+		const double seconds = time_it( [&]() { store.set_many( rows.data(), cols.data(), vals.data(), n ); } );
+		report<T>( "set_many_random", shape, n, bytes, seconds );
+	}
+}
+
+template <typename T>
+void bench_get( const OffsetMatrix<T>& store, const Shape& shape, std::mt19937& rng )
+{
+	const size_t n = shape.rows * shape.cols;
+
+	// a quarter of the lookups miss the stored values
+	std::vector<size_t> rows( n ), cols( n );
+	for( size_t k=0; k<n; ++k )
+	{
+		rows[k] = rng() % (shape.rows + shape.rows / 4 +1);
+		cols[k] = rng() % (shape.cols + shape.cols / 4 +1);
+	}
+
+	{
+		size_t found = 0;
+		const double seconds = time_it( [&]()
+		{
+			for( size_t k=0; k<n; ++k )
+				found += store.get( rows[k], cols[k] ) != store.defaultValue;
+		} );
+		sink += found;
+		report<T>( "get_point_random", shape, n, sizeof(T) * n, seconds );
+	}
+
+	{
+		size_t found = 0;
+		const double seconds = time_it( [&]()
+		{
+			for( size_t row=0; row<shape.rows; ++row )
+				for( size_t col=0; col<shape.cols; ++col )
+					found += store.get( row, col ) != store.defaultValue;
+		} );
+		sink += found;
+		report<T>( "get_point_sequential", shape, n, sizeof(T) * n, seconds );
+	}
+
+	{
+		std::vector<T> out( n );
+		const double seconds = time_it( [&]() { store.get_many( rows.data(), cols.data(), out.data(), n ); } );
+		sink += out[ n / 2 ] != store.defaultValue;
+		report<T>( "get_many_random", shape, n, sizeof(T) * n, seconds );
+	}
+}
+
+template <typename T>
+void bench_scan( const OffsetMatrix<T>& store, const Shape& shape )
+{
+	const size_t n = store.values();
+
+	{
+		size_t found = 0;
+		const double seconds = time_it( [&]()
+		{
+			for( const auto e : store.elements() )
+				found += e.value != store.defaultValue;
+		} );
+		sink += found;
+		report<T>( "scan_elements", shape, n, sizeof(T) * n, seconds );
+	}
+
+	{
+		size_t found = 0;
+		const double seconds = time_it( [&]() { found = store.count( value_at<T>( 0, 0 ) ); } );
+		sink += found;
+		report<T>( "count", shape, n, sizeof(T) * n, seconds );
+	}
+
+	{
+		std::vector<T> column( store.size() );
+		const double seconds = time_it( [&]()
+		{
+			for( size_t col=0; col<shape.cols; ++col )
+				store.get_column( col, column.data() );
+		} );
+		sink += column[0] != store.defaultValue;
+		report<T>( "get_column", shape, n, sizeof(T) * n, seconds );
+	}
+
+	{
+		size_t rows = 0;
+		const double seconds = time_it( [&]() { rows = store.transpose( 0 ).size(); } );
+		sink += rows;
+		report<T>( "transpose", shape, n, sizeof(T) * n, seconds );
+	}
+}
+
+template <typename T>
+void bench_file( const OffsetMatrix<T>& store, const Shape& shape )
+{
+	const size_t n = store.values();
+	const size_t bytes = sizeof(T) * n;
+
+	report<T>( "save", shape, n, bytes, time_it( [&]() { sink += store.save( benchFile ); } ) );
+
+	SaveOptions options;
+	options.threads = 0;
+	report<T>( "save_parallel", shape, n, bytes, time_it( [&]() { sink += store.save( benchFile, options ); } ) );
+
+	OffsetMatrix<T> loaded( T(0) );
+	report<T>( "load", shape, n, bytes, time_it( [&]() { sink += loaded.load( benchFile ); } ) );
+
+	LoadOptions loadOptions;
+	loadOptions.threads = 0;
+	report<T>( "load_parallel", shape, n, bytes, time_it( [&]() { sink += loaded.load( benchFile, loadOptions ); } ) );
+
+	remove( benchFile );
+}
+
+template <typename T>
+void bench( const Shape& shape )
+{
+	std::mt19937 rng( 42 );
+
+	bench_set<T>( shape, rng );
+
+	OffsetMatrix<T> store( T(0) );
+	fill( store, shape );
+
+	bench_get<T>( store, shape, rng );
+	bench_scan<T>( store, shape );
+	bench_file<T>( store, shape );
+}
+
+template <typename T>
+void bench_all( const std::vector<Shape>& shapes )
+{
+	for( const Shape &shape : shapes )
+		bench<T>( shape );
+}
+
+int main( int argc, char** argv )
+{
+	const size_t values = argc > 1 ? std::strtoul( argv[1], nullptr, 10 ) : 1 << 20;
+	const size_t side = std::max( (size_t)std::sqrt( (double)values ), (size_t)1 );
+	const size_t narrow = 16;
+
+	const std::vector<Shape> shapes = {
+		{ side, side },
+		{ narrow, std::max( values / narrow, (size_t)1 ) },    // wide
+		{ std::max( values / narrow, (size_t)1 ), narrow },    // tall
+	};
+
+	std::cout << "# case\ttype\ttype_bytes\trows\tcols\tops\tseconds\tops_per_sec\tmb_per_sec\n";
+
+	bench_all<uint8_t>( shapes );
+	bench_all<int32_t>( shapes );
+	bench_all<double>( shapes );
+	bench_all<Wide>( shapes );
+
+	return sink == (size_t)-1;
+}
@@ -0,0 +1,253 @@
+#ifndef OFFSETBUFFER_H
+#define OFFSETBUFFER_H
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include "offsetstats.h"
+
+namespace offset
+{
+
+/* contiguous buffer that can grow at both ends.
+	keeps a run of spare slots (headroom) in front of the first element so
+	that growing the front is amortized O(1), the same as growing the back */
+template <typename T, typename Alloc = std::allocator<T> >
+class OffsetBuffer : private std::vector<T, Alloc>
+{
+private:
+	typedef std::vector<T, Alloc> Base;
+
+	size_t hd = 0; // number of headroom slots before the first element
+
+	/* move the elements up so that there are front headroom slots,
+		within the current allocation. only for trivially copyable T */
+	void slide( const size_t front, std::true_type );
+	void slide( const size_t, std::false_type ) {}
+
+	/* count the reallocation if holding s elements needs one, see offsetstats.h */
+	void count_back_growth( const size_t s ) const
+	{
+#if defined(OFFSET_STATS)
+		if( hd + s > Base::capacity() )
+		{
+			OFFSET_COUNT( backGrows, 1 );
+			OFFSET_COUNT( elementsMoved, size() );
+		}
+#else
+		(void)s;
+#endif
+	}
+
+public:
+	typedef typename Base::iterator iterator;
+	typedef typename Base::const_iterator const_iterator;
+	typedef typename Base::reverse_iterator reverse_iterator;
+	typedef typename Base::const_reverse_iterator const_reverse_iterator;
+
+	typedef Alloc allocator_type;
+
+	// empty constructor
+	OffsetBuffer( const Alloc& alloc=Alloc() ) : Base( alloc ) {}
+
+	// constructor
+	OffsetBuffer( const size_t s, const T& val, const Alloc& alloc=Alloc() ) : Base( s, val, alloc ) {}
+
+	// iterator constructor
+	template <typename iter>
+	OffsetBuffer( iter begin, iter end, const Alloc& alloc=Alloc() ) : Base( begin, end, alloc ) {}
+
+	// copy constructor, headroom is not copied
+	OffsetBuffer( const OffsetBuffer<T, Alloc>& other ) :
+		Base( other.begin(), other.end(),
+			  std::allocator_traits<Alloc>::select_on_container_copy_construction( other.get_allocator() ) ) {}
+
+	// move constructor
+	OffsetBuffer( OffsetBuffer<T, Alloc>&& other ) noexcept :
+		Base( std::move(other) ), hd( other.hd ) { other.hd = 0; }
+
+	/* copy assignment, the headroom is copied too so that the allocator
+		propagates the same way it would for a std::vector */
+	OffsetBuffer<T, Alloc>& operator=( const OffsetBuffer<T, Alloc>& other )
+	{
+		if( this != &other )
+		{
+			Base::operator=( static_cast<const Base&>( other ) );
+			hd = other.hd;
+		}
+		return *this;
+	}
+
+	// move assignment
+	OffsetBuffer<T, Alloc>& operator=( OffsetBuffer<T, Alloc>&& other ) noexcept
+	{
+		Base::operator=( std::move(other) );
+		hd = other.hd;
+		other.hd = 0;
+		return *this;
+	}
+
+	iterator begin() { return std::next( Base::begin(), hd ); }
+	const_iterator begin() const { return std::next( Base::begin(), hd ); }
+	iterator end() { return Base::end(); }
+	const_iterator end() const { return Base::end(); }
+
+	reverse_iterator rbegin() { return reverse_iterator( end() ); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator( end() ); }
+	reverse_iterator rend() { return reverse_iterator( begin() ); }
+	const_reverse_iterator rend() const { return const_reverse_iterator( begin() ); }
+
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	T& front() { return *begin(); }
+	const T& front() const { return *begin(); }
+	using Base::back;
+
+	using Base::get_allocator;
+
+	T& operator[]( const size_t i ) { return Base::operator[]( hd + i ); }
+	const T& operator[]( const size_t i ) const { return Base::operator[]( hd + i ); }
+
+	T* data() { return Base::data() + hd; }
+	const T* data() const { return Base::data() + hd; }
+
+	size_t size() const { return Base::size() - hd; }
+	bool empty() const { return size() == 0; }
+
+	/* number of elements that can be added to the front/back before reallocating */
+	size_t front_capacity() const { return hd; }
+	size_t back_capacity() const { return Base::capacity() - Base::size(); }
+
+	void resize( const size_t s )
+	{
+		count_back_growth( s );
+		Base::resize( hd + s );
+	}
+
+	void resize( const size_t s, const T& val )
+	{
+		count_back_growth( s );
+		Base::resize( hd + s, val );
+	}
+
+	void clear()
+	{
+		Base::clear();
+		hd = 0;
+	}
+
+	/* remove all elements and place the (future) first element at
+		slot front of the existing allocation, so that front elements
+		can later be added before it without reallocating */
+	void reset( const size_t front );
+
+	/* make sure that front elements can be added before the first element
+		and back elements after the last one without reallocating */
+	void reserve( size_t front, size_t back );
+	void reserve_front( const size_t front ) { reserve( front, 0 ); }
+	void reserve_back( const size_t back ) { reserve( 0, back ); }
+
+	/* add n elements with value val to the front of the buffer.
+		headroom grows geometrically so repeated calls are amortized O(1) */
+	void grow_front( const size_t n, const T& val );
+
+	/* remove the first n elements, their slots become headroom */
+	void erase_front( const size_t n ) { hd += std::min( n, size() ); }
+
+	/* release all spare capacity at both ends */
+	void shrink_to_fit();
+};
+
+template <typename T, typename Alloc>
+void OffsetBuffer<T, Alloc>::reset( const size_t front )
+{
+	Base::clear();
+	Base::resize( front );
+	hd = front;
+}
+
+template <typename T, typename Alloc>
+void OffsetBuffer<T, Alloc>::reserve( size_t front, size_t back )
+{
+	if( front <= front_capacity() && back <= back_capacity() ) return;
+
+	/* only the back needs to grow, vector can do that in place */
+	if( front <= front_capacity() )
+	{
+		count_back_growth( size() + back );
+		Base::reserve( Base::size() + back );
+		return;
+	}
+
+	/* the allocation is already big enough, trivially copyable elements
+		can be moved up into the spare back capacity with one memmove
+		rather than copying everything into a new allocation */
+	if( std::is_trivially_copyable<T>::value && front + size() + back <= Base::capacity() )
+	{
+		slide( front, std::is_trivially_copyable<T>() );
+		return;
+	}
+
+	front = std::max( front, front_capacity() );
+	back = std::max( back, back_capacity() );
+
+	Base buffer( get_allocator() );
+	buffer.reserve( front + size() + back );
+	buffer.resize( front );
+	buffer.insert( buffer.end(), std::make_move_iterator( begin() ),
+								 std::make_move_iterator( end() ) );
+
+	OFFSET_COUNT( frontGrows, 1 );
+	OFFSET_COUNT( elementsMoved, size() );
+
+	Base::swap( buffer );
+	hd = front;
+}
+
+template <typename T, typename Alloc>
+void OffsetBuffer<T, Alloc>::slide( const size_t front, std::true_type )
+{
+	const size_t n = size();
+
+	OFFSET_COUNT( slides, 1 );
+	OFFSET_COUNT( elementsMoved, n );
+
+	Base::resize( front + n );
+	if( n > 0 ) memmove( Base::data() + front, Base::data() + hd, sizeof(T) * n );
+	hd = front;
+}
+
+template <typename T, typename Alloc>
+void OffsetBuffer<T, Alloc>::grow_front( const size_t n, const T& val )
+{
+	/* double the buffer so the cost of the move is spread over the
+		next size() front insertions */
+	if( n > front_capacity() )
+		reserve_front( n + size() );
+
+	hd -= n;
+	std::fill( begin(), std::next( begin(), n ), val );
+}
+
+template <typename T, typename Alloc>
+void OffsetBuffer<T, Alloc>::shrink_to_fit()
+{
+	if( hd > 0 )
+	{
+		Base buffer( std::make_move_iterator( begin() ),
+					 std::make_move_iterator( end() ), get_allocator() );
+		Base::swap( buffer );
+		hd = 0;
+	}
+
+	Base::shrink_to_fit();
+}
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef OFFSETCODEC_H
+#define OFFSETCODEC_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(LIBZSTD)
+	#include <zstd.h>
+#endif
+
+namespace offset
+{
+
+namespace format
+{
+
+/* row payload encodings */
+enum Codec : uint32_t
+{
+	RAW = 0,  // colsNum values of T stored as is
+	RLE = 1,  // runs of a fill value (normally the default value) left out, see encode_rle()
+	ZSTD = 2  // values compressed with zstd, only available when built with -DLIBZSTD
+};
+
+/* true if this build can encode and decode codec */
+inline bool available( const Codec codec )
+{
+#if defined(LIBZSTD)
+	return codec == RAW || codec == RLE || codec == ZSTD;
+#else
+	return codec == RAW || codec == RLE;
+#endif
+}
+
+/* run length encoding of the fill value.
+
+	[fill value]
+	 typedef T
+	[fill values to skip][values that follow][1st value]...[last value]
+	 uint64_t             uint64_t            typedef T      typedef T
+	...
+
+	columns not covered by a record hold the fill value */
+template <typename T>
+void encode_rle( const T* values, const size_t n, const T& fill, std::vector<char>& out )
+{
+	auto append = [&out]( const void* data, const size_t bytes )
+	{
+		const char* pos = static_cast<const char*>( data );
+		out.insert( out.end(), pos, pos + bytes );
+	};
+
+	// runs of fill shorter than a record header are cheaper kept as values
+	const size_t minRun = 2 * sizeof(uint64_t) / sizeof(T) +1;
+
+	append( &fill, sizeof(T) );
+
+	size_t i = 0;
+	while( i < n )
+	{
+		const size_t start = i;
+		while( i < n && values[i] == fill ) ++i;
+		const size_t gap = i - start;
+
+		const size_t first = i;
+		while( i < n )
+		{
+			if( !(values[i] == fill) )
+			{
+				++i;
+				continue;
+			}
+
+			size_t run = i;
+			while( run < n && values[run] == fill ) ++run;
+			if( run == n || run - i >= minRun ) break;
+
+			i = run;
+		}
+
+		if( i == first ) break; // only fill left
+
+		const uint64_t record[2] = { gap, i - first };
+		append( record, sizeof(record) );
+		append( values + first, sizeof(T) * (i - first) );
+	}
+}
+
+/* returns true if error */
+template <typename T>
+bool decode_rle( const char* in, const size_t bytes, T* values, const size_t n )
+{
+	if( bytes < sizeof(T) ) return true;
+
+	T fill;
+	memcpy( &fill, in, sizeof(T) );
+	std::fill( values, values + n, fill );
+
+	size_t pos = sizeof(T), col = 0;
+	while( pos < bytes )
+	{
+		uint64_t record[2];
+		if( bytes - pos < sizeof(record) ) return true;
+		memcpy( record, in + pos, sizeof(record) );
+		pos += sizeof(record);
+
+		if( record[0] > n - col ) return true;
+		col += record[0];
+
+		if( record[1] > n - col || (bytes - pos) / sizeof(T) < record[1] ) return true;
+		memcpy( values + col, in + pos, sizeof(T) * record[1] );
+		pos += sizeof(T) * record[1];
+		col += record[1];
+	}
+
+	return false;
+}
+
+/* encode n values with codec into out, replacing its contents.
+	fill is the value left out by RLE, level is the zstd compression level.
+	returns the codec actually used, this is RAW (and out is empty) if
+	codec is not available in this build or would not make the row smaller,
+	in which case the values should be stored as they are */
+template <typename T>
+Codec encode( const Codec codec, const T* values, const size_t n, const T& fill,
+			  std::vector<char>& out, const int level=3 )
+{
+	out.clear();
+
+	const size_t raw = sizeof(T) * n;
+	if( codec == RLE )
+	{
+		encode_rle( values, n, fill, out );
+	}
+#if defined(LIBZSTD)
+	else if( codec == ZSTD )
+	{
+		out.resize( ZSTD_compressBound( raw ) );
+		const size_t bytes = ZSTD_compress( out.data(), out.size(), values, raw, level );
+		out.resize( ZSTD_isError( bytes ) ? 0 : bytes );
+	}
+#else
+	(void)level;
+#endif
+
+	if( out.empty() || out.size() >= raw )
+	{
+		out.clear();
+		return RAW;
+	}
+
+	return codec;
+}
+
+/* decode bytes of in, written by encode() with codec, into n values.
+	returns true if error */
+template <typename T>
+bool decode( const Codec codec, const char* in, const size_t bytes, T* values, const size_t n )
+{
+	switch( codec )
+	{
+	case RAW:
+		if( bytes != sizeof(T) * n ) return true;
+		if( bytes > 0 ) memcpy( values, in, bytes );
+		return false;
+
+	case RLE:
+		return decode_rle( in, bytes, values, n );
+
+#if defined(LIBZSTD)
+	case ZSTD:
+		return ZSTD_decompress( values, sizeof(T) * n, in, bytes ) != sizeof(T) * n;
+#endif
+
+	default:
+		return true;
+	}
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include <cxxtest/TestSuite.h>
+#include "offsetcodec.h"
+
+using namespace offset;
+
+class OffsetCodecTest: public CxxTest::TestSuite
+{
+private:
+	std::vector<int> values;
+	int defaultValue;
+
+	void roundtrip( const format::Codec codec, const std::vector<int> &in )
+	{
+		std::vector<char> encoded;
+		const format::Codec used = format::encode( codec, in.data(), in.size(), defaultValue, encoded );
+
+		std::vector<char> raw( (const char*)in.data(), (const char*)(in.data() + in.size()) );
+		const std::vector<char> &payload = used == format::RAW ? raw : encoded;
+
+		std::vector<int> out( in.size(), 0 );
+		TS_ASSERT( !format::decode( used, payload.data(), payload.size(), out.data(), out.size() ) );
+		TS_ASSERT( in == out );
+	}
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+
+		// mostly default with a few runs of other values
+		values.assign( 1000, defaultValue );
+		for( size_t i=100; i<110; ++i ) values[i] = (int)i;
+		values[500] = 1;
+		values[502] = 2; // short gap kept in the same run
+		values[999] = 3;
+	}
+
+	void test_rle()
+	{
+		std::vector<char> encoded;
+		TS_ASSERT_EQUALS( format::RLE, format::encode( format::RLE, values.data(), values.size(), defaultValue, encoded ) );
+		TS_ASSERT_LESS_THAN( encoded.size(), sizeof(int) * values.size() / 10 );
+
+		roundtrip( format::RLE, values );
+	}
+
+	void test_rle_edges()
+	{
+		roundtrip( format::RLE, std::vector<int>() );
+		roundtrip( format::RLE, std::vector<int>( 10, defaultValue ) );
+		roundtrip( format::RLE, std::vector<int>( 10, 1 ) );
+		roundtrip( format::RLE, std::vector<int>{ 1, defaultValue, defaultValue, defaultValue, defaultValue, defaultValue, 2 } );
+	}
+
+	void test_not_smaller()
+	{
+		// nothing to leave out, so the row is kept raw
+		std::vector<int> dense( 100 );
+		for( size_t i=0; i<dense.size(); ++i ) dense[i] = (int)i;
+
+		std::vector<char> encoded;
+		TS_ASSERT_EQUALS( format::RAW, format::encode( format::RLE, dense.data(), dense.size(), defaultValue, encoded ) );
+		TS_ASSERT( encoded.empty() );
+	}
+
+	void test_corrupt()
+	{
+		std::vector<char> encoded;
+		format::encode( format::RLE, values.data(), values.size(), defaultValue, encoded );
+
+		// decoding into a shorter row must fail rather than overrun it
+		std::vector<int> out( values.size() / 2 );
+		TS_ASSERT( format::decode( format::RLE, encoded.data(), encoded.size(), out.data(), out.size() ) );
+		TS_ASSERT( format::decode( format::RLE, encoded.data(), encoded.size() -1, out.data(), out.size() ) );
+	}
+
+	void test_zstd()
+	{
+		// only built in with -DLIBZSTD
+		if( !format::available( format::ZSTD ) ) return;
+
+		roundtrip( format::ZSTD, values );
+	}
+};
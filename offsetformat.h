@@ -0,0 +1,381 @@
+#ifndef OFFSETFORMAT_H
+#define OFFSETFORMAT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "offsetcodec.h"
+
+namespace offset
+{
+
+/* on disk layout used by OffsetMatrix::save() (version 2).
+
+	[header]                       64 bytes, see Header
+	[1st row values]               starts on an alignment boundary
+	[padding]
+	[2nd row values]               starts on an alignment boundary
+	[padding]
+	...
+	[row table]                    starts on an alignment boundary,
+	                               one RowEntry per row, in row order
+
+	row values may be encoded, the codec of each row is kept in its 
+	RowEntry, see offsetcodec.h
+
+	rows with the same colsMin and values can share one payload, their
+	entries then have the same offset and bytes (see SaveOptions::dedup).
+	reading needs nothing special, anything that rewrites a row payload
+	in place has to check it isn't shared first
+
+	all fields are written in the byte order of the machine that saved
+	the file, readers refuse files whose byteOrder does not match.
+
+	the original layout (version 1) has no header at all, it starts with
+	the total number of values, see OffsetMatrix::save_v1()
+
+	delta files written by OffsetMatrix::save_delta() have the same layout
+	with delta_magic() in place of magic() and a DeltaEntry for each changed
+	row in place of the row table. rowsMin and rowsNum in their header are 
+	the rows of the whole matrix when the delta was saved, rowsNum the
+	number of entries in the table is tableRows. the deltas saved against a 
+	base file are listed, oldest first and one per line, in the manifest
+	file manifest( base ). a full save over base removes its manifest */
+namespace format
+{
+
+const uint32_t version = 2;
+const uint32_t alignment = 64;
+const uint32_t byteOrder = 0x01020304;
+
+inline const char* magic() { return "OFFSTORE"; }
+inline const char* delta_magic() { return "OFFDELTA"; }
+const size_t magicSize = 8;
+
+inline std::string manifest( const std::string& base ) { return base + ".manifest"; }
+
+struct Header
+{
+	char magic[magicSize];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t valueSize;    // sizeof(T) of the saved matrix
+	uint32_t alignment;    // row payloads start on multiples of this
+	uint64_t total;        // total number of values stored
+	uint64_t rowsMin;      // minimum row number
+	uint64_t rowsNum;      // number of rows
+	uint64_t tableOffset;  // file position of the row table
+	uint64_t tableRows;    // entries in the table of a delta file, 0 otherwise
+};
+static_assert( sizeof(Header) == 64, "header must stay 64 bytes" );
+
+struct RowEntry
+{
+	uint64_t colsMin;      // minimum col number in the row
+	uint64_t colsNum;      // number of columns in the row
+	uint64_t offset;       // file position of the row payload
+	uint64_t bytes;        // size of the (encoded) row payload
+	uint32_t codec;        // how the payload is encoded, see Codec
+	uint32_t reserved;
+};
+static_assert( sizeof(RowEntry) == 40, "row entry must stay 40 bytes" );
+
+struct DeltaEntry
+{
+	uint64_t row;          // row number the entry replaces
+	RowEntry entry;
+};
+static_assert( sizeof(DeltaEntry) == 48, "delta entry must stay 48 bytes" );
+
+/* round pos up to the next alignment boundary */
+inline uint64_t align( const uint64_t pos )
+{
+	return (pos + alignment -1) / alignment * alignment;
+}
+
+/* 64 bit FNV-1a hash of bytes, a word at a time, starting from seed */
+inline uint64_t hash( const void* data, const size_t bytes, uint64_t seed=14695981039346656037ull )
+{
+	const uint64_t prime = 1099511628211ull;
+	const char* p = static_cast<const char*>( data );
+
+	size_t i = 0;
+	for( ; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t) )
+	{
+		uint64_t word;
+		memcpy( &word, p + i, sizeof(word) );
+		seed = (seed ^ word) * prime;
+	}
+	for( ; i < bytes; ++i )
+		seed = (seed ^ (unsigned char)p[i]) * prime;
+
+	return seed;
+}
+
+/* for each of n rows the first row with the same min() and values as it,
+	itself if there is none before it. row( i ) returns a pointer to row i,
+	anything with min(), size() and data(), or nullptr for a row that 
+	doesn't exist. rows with nothing stored are never matched */
+template <typename T, typename F>
+std::vector<size_t> find_duplicates( const size_t n, F row )
+{
+	std::vector<size_t> first( n );
+	std::unordered_map< uint64_t, std::vector<size_t> > seen;
+
+	for( size_t i=0; i<n; ++i )
+	{
+		first[i] = i;
+
+		const auto r = row( i );
+		if( !r || r->size() == 0 ) continue;
+
+		const uint64_t colsMin = r->min();
+		std::vector<size_t> &same = seen[ hash( r->data(), sizeof(T) * r->size(), hash( &colsMin, sizeof(colsMin) ) ) ];
+
+		for( const size_t j : same )
+		{
+			const auto other = row( j );
+			if( other->min() == r->min() && other->size() == r->size() &&
+				memcmp( other->data(), r->data(), sizeof(T) * r->size() ) == 0 )
+			{
+				first[i] = j;
+				break;
+			}
+		}
+
+		if( first[i] == i ) same.push_back( i );
+	}
+
+	return first;
+}
+
+/* true if the start of a file looks like a version 2 file */
+inline bool is_v2( const char* start, const size_t length )
+{
+	return length >= magicSize && memcmp( start, magic(), magicSize ) == 0;
+}
+
+template <typename T>
+Header make_header( const uint64_t total, const uint64_t rowsMin, const uint64_t rowsNum,
+					const uint64_t tableOffset )
+{
+	Header header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, magic(), magicSize );
+	header.version = version;
+	header.byteOrder = byteOrder;
+	header.valueSize = sizeof(T);
+	header.alignment = alignment;
+	header.total = total;
+	header.rowsMin = rowsMin;
+	header.rowsNum = rowsNum;
+	header.tableOffset = tableOffset;
+
+	return header;
+}
+
+/* returns true if error, i.e. the header can not be read as a matrix of T 
+	from a file starting with expected */
+template <typename T>
+bool check_header( const Header& header, const char* expected=magic() )
+{
+	return memcmp( header.magic, expected, magicSize ) != 0 ||
+			header.version != version ||
+			header.byteOrder != byteOrder ||
+			header.valueSize != sizeof(T) ||
+			header.alignment == 0 ||
+			header.tableOffset % header.alignment != 0;
+}
+
+/* read exactly bytes from fd at offset, returns true if error */
+inline bool pread_all( const int fd, void* buffer, size_t bytes, uint64_t offset )
+{
+	char* pos = static_cast<char*>( buffer );
+	while( bytes > 0 )
+	{
+		const ssize_t n = ::pread( fd, pos, bytes, offset );
+		if( n <= 0 ) return true;
+
+		pos += n;
+		bytes -= n;
+		offset += n;
+	}
+
+	return false;
+}
+
+/* write exactly bytes to fd at offset, returns true if error */
+inline bool pwrite_all( const int fd, const void* buffer, size_t bytes, uint64_t offset )
+{
+	const char* pos = static_cast<const char*>( buffer );
+	while( bytes > 0 )
+	{
+		const ssize_t n = ::pwrite( fd, pos, bytes, offset );
+		if( n <= 0 ) return true;
+
+		pos += n;
+		bytes -= n;
+		offset += n;
+	}
+
+	return false;
+}
+
+/* buffered writer for an open file starting at offset.
+	small writes are gathered into one large buffer so that a row costs a 
+	memcpy rather than a syscall, writes larger than the buffer go straight 
+	to the file */
+class Writer
+{
+private:
+	int fd;
+	uint64_t pos;   // file position of the start of the buffer
+	std::vector<char> buffer;
+	size_t used = 0;
+	bool failed = false;
+
+public:
+	Writer( const int fd, const uint64_t offset, const size_t bufferSize ) :
+		fd(fd), pos(offset), buffer( std::max( bufferSize, (size_t)alignment ) ) {}
+
+	~Writer() { flush(); }
+
+	/* file position the next write goes to */
+	uint64_t position() const { return pos + used; }
+
+	bool fail() const { return failed; }
+
+	void write( const void* data, const size_t bytes )
+	{
+		if( used + bytes > buffer.size() ) flush();
+
+		if( bytes >= buffer.size() )
+		{
+			failed |= pwrite_all( fd, data, bytes, pos );
+			pos += bytes;
+			return;
+		}
+
+		if( bytes > 0 ) memcpy( buffer.data() + used, data, bytes );
+		used += bytes;
+	}
+
+	/* write zeros up to the file position offset */
+	void pad( const uint64_t offset )
+	{
+		static const char zeros[alignment] = {};
+		while( position() < offset )
+			write( zeros, std::min( offset - position(), (uint64_t)alignment ) );
+	}
+
+	/* write out anything buffered, returns true if error */
+	bool flush()
+	{
+		if( used > 0 )
+		{
+			failed |= pwrite_all( fd, buffer.data(), used, pos );
+			pos += used;
+			used = 0;
+		}
+
+		return failed;
+	}
+};
+
+/* read the header and row table of an open version 2 file.
+	returns true if error */
+template <typename T>
+bool read_index( const int fd, Header& header, std::vector<RowEntry>& table )
+{
+	if( pread_all( fd, &header, sizeof(header), 0 ) || check_header<T>( header ) )
+		return true;
+
+	table.resize( header.rowsNum );
+	return pread_all( fd, table.data(), sizeof(RowEntry) * table.size(), header.tableOffset );
+}
+
+/* random access to a single row, reads the payload of entry into values
+	with one pread and decodes it if needed. values must have room for 
+	entry.colsNum elements, scratch holds encoded payloads.
+	returns true if error */
+template <typename T>
+bool read_row( const int fd, const RowEntry& entry, T* values, std::vector<char>& scratch )
+{
+	if( entry.codec == RAW )
+	{
+		if( entry.bytes != sizeof(T) * entry.colsNum ) return true;
+		return pread_all( fd, values, entry.bytes, entry.offset );
+	}
+
+	scratch.resize( entry.bytes );
+	return pread_all( fd, scratch.data(), entry.bytes, entry.offset ) ||
+			decode( static_cast<Codec>( entry.codec ), scratch.data(), entry.bytes, values, entry.colsNum );
+}
+
+template <typename T>
+bool read_row( const int fd, const RowEntry& entry, T* values )
+{
+	std::vector<char> scratch;
+	return read_row( fd, entry, values, scratch );
+}
+
+/* read the header and table of an open delta file.
+	returns true if error */
+template <typename T>
+bool read_delta_index( const int fd, Header& header, std::vector<DeltaEntry>& table )
+{
+	if( pread_all( fd, &header, sizeof(header), 0 ) || check_header<T>( header, delta_magic() ) )
+		return true;
+
+	table.resize( header.tableRows );
+	return pread_all( fd, table.data(), sizeof(DeltaEntry) * table.size(), header.tableOffset );
+}
+
+/* the files listed in the manifest of base, oldest first, none if
+	there is no manifest. returns true if error */
+inline bool read_manifest( const std::string& base, std::vector<std::string>& deltas )
+{
+	deltas.clear();
+
+	std::ifstream file( manifest( base ) );
+	if( !file.is_open() ) return false;
+
+	std::string line;
+	while( std::getline( file, line ) )
+		if( !line.empty() ) deltas.push_back( line );
+
+	return file.bad();
+}
+
+/* remove the manifest of base, for when base is saved over and the deltas
+	taken against the old one no longer apply. no manifest isn't an error.
+	returns true if error */
+inline bool remove_manifest( const std::string& base )
+{
+	return std::remove( manifest( base ).c_str() ) != 0 && errno != ENOENT;
+}
+
+/* add delta to the end of the manifest of base. returns true if error */
+inline bool append_manifest( const std::string& base, const std::string& delta )
+{
+	std::ofstream file( manifest( base ), std::ios::app );
+	file << delta << '\n';
+	file.close();
+
+	return file.fail();
+}
+
+}
+
+}
+
+#endif
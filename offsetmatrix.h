@@ -6,8 +6,26 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <future>
 #include <iomanip>
-
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "frozenoffsetmatrix.h"
+#include "offsetarena.h"
+#include "offsetbuffer.h"
+#include "offsetformat.h"
+#include "offsetmatrixiterator.h"
+#include "offsetparallel.h"
+#include "offsetslice.h"
+#include "offsetstats.h"
 #include "offsetvector.h"
 
 #if defined(BOOST)
@@ -17,11 +35,117 @@
 namespace offset
 {
 
-template <typename T>
-class OffsetMatrix : private std::vector< OffsetVector<T> >
+/* options for OffsetMatrix::save() */
+struct SaveOptions
+{
+	bool verbose = false;
+	std::ostream* output = &std::cout;
+
+	size_t threads = 1;            // threads writing rows in parallel (0 = one per core)
+	size_t bufferSize = 4 << 20;   // bytes gathered before each write, per thread
+	size_t progressRows = 0;       // report progress at most every progressRows rows (0 = off)
+	size_t progressMs = 250;       // ...or every progressMs milliseconds (0 = off)
+
+	format::Codec codec = format::RAW; // how row payloads are encoded, rows that would
+	                                   // not get smaller are stored RAW anyway
+	int level = 3;                 // compression level for format::ZSTD
+
+	bool dedup = false;            // store rows with the same min() and values once,
+	                               // their row table entries point at the one payload
+};
+
+/* options for OffsetMatrix::load() */
+struct LoadOptions
+{
+	bool verbose = false;
+	std::ostream* output = &std::cout;
+
+	size_t threads = 1;            // threads reading rows in parallel (0 = one per core),
+	                               // only version 2 files can be read in parallel
+};
+
+/* what a save() call did */
+struct SaveStats
+{
+	uint64_t bytes = 0;            // size of the file written
+	double seconds = 0;
+
+	double throughput() const { return seconds > 0 ? bytes / seconds : 0; } // bytes per second
+};
+
+/* throttled progress output for save(), 
+	prints the number of rows done so far at most every rows rows or ms milliseconds */
+class Progress
+{
+private:
+	std::ostream* output;
+	size_t total, rows;
+	std::chrono::milliseconds ms;
+
+	size_t count = 0, last = 0;
+	std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+
+	void print()
+	{
+		*output << count << "/" << total << "\r" << std::flush;
+		last = count;
+		lastTime = std::chrono::steady_clock::now();
+	}
+
+public:
+	Progress( std::ostream* output, const size_t total, const size_t rows, const size_t ms ) :
+		output(output), total(total), rows(rows), ms(ms) {}
+
+	Progress( const SaveOptions& options, const size_t total ) :
+		Progress( options.verbose ? options.output : nullptr, total, 
+				  options.progressRows, options.progressMs ) {}
+
+	void step( const size_t n=1 )
+	{
+		count += n;
+		if( !output ) return;
+
+		// only look at the clock every so often, it is not free either
+		if( (rows > 0 && count - last >= rows) ||
+			 (ms.count() > 0 && (count & 0xff) == 0 && std::chrono::steady_clock::now() - lastTime >= ms) )
+			print();
+	}
+
+	void finish()
+	{
+		if( !output ) return;
+
+		print();
+		*output << std::endl;
+	}
+};
+
+/* allocator of the row store, the row's allocator rebound to rows */
+template <typename RowType>
+using RowStoreAllocator = typename std::allocator_traits< 
+	typename RowType::allocator_type >::template rebind_alloc< RowType >;
+
+/* RowType is the type used for each row, OffsetVector<T> stores every row
+	as one dense run of columns, OffsetSparseVector<T> as several runs for
+	rows with large gaps. saving and loading need dense rows.
+
+	the allocator is the row's, OffsetVector<T, ArenaAllocator<T>> puts 
+	the values of every row, and the row store itself, in an arena.
+	OffsetVector<T, std::allocator<T>, ConstantDefault<T, V>> rows don't
+	keep a copy of the default value each, V should match defaultValue */
+template <typename T, typename RowType = OffsetVector<T> >
+class OffsetMatrix : private OffsetBuffer< RowType, RowStoreAllocator<RowType> >
 {
+private:
+	typedef OffsetBuffer< RowType, RowStoreAllocator<RowType> > Rows;
+
 public:
-	typedef OffsetVector<T> Row;
+	typedef RowType Row;
+	typedef typename Row::allocator_type allocator_type;
+
+	/* iterators over every stored value as (row, col, value&), see elements() */
+	typedef OffsetMatrixIterator< typename Rows::iterator, T > element_iterator;
+	typedef OffsetMatrixIterator< typename Rows::const_iterator, const T > const_element_iterator;
 	size_t mn = 0;
 
 	/* return a reference to the row requested. takes parameter row which is the desired 
@@ -32,42 +156,275 @@ public:
 		only use if row >= min() && row <= max() && !empty() */
 	const Row& get_row( size_t row ) const;
 
+	/* start or stop recording the rows that change, see save_delta().
+		set(), set_many(), get_row(), find() and clear() record the rows
+		they touch, changes through at_unchecked(), elements() or held row
+		references are only recorded if the row was also touched by one of
+		them. load() starts again with no changes */
+	void track_changes( bool on=true ) { tracking = on; lastChange = -1; }
+	bool tracking_changes() const { return tracking; }
+
+	/* number of rows changed so far */
+	size_t changed_rows() const { return changes.size(); }
+	void clear_changes() { changes.clear(); lastChange = -1; }
+
+	/* write the rows changed since tracking started, or since the last
+		save_delta(), to the delta file filename and add it to the manifest
+		of base, see offsetformat.h. base is the file the matrix was last
+		save()d to, or loaded from with load_chain(). clears the changes.
+		returns true if error, including if changes aren't being tracked */
+	bool save_delta( std::string base, std::string filename );
+
+	/* load base and then replay every delta in its manifest, oldest first.
+		returns true if error */
+	bool load_chain( std::string base );
+
+	/* fold the deltas of base back into it, base is replaced with a full
+		save() of load_chain( base ) and the deltas and the manifest are
+		removed. the matrix is left holding the result. returns true if error */
+	bool compact_chain( std::string base );
+
+private:
+	/* write the rows of save() to fd, either straight from memory or 
+		encoded with options.codec. fills in table and tableOffset.
+		returns true if error */
+	bool save_raw( const int fd, const SaveOptions& options, Progress& progress,
+				   std::vector<format::RowEntry>& table, uint64_t& tableOffset ) const;
+	bool save_encoded( const int fd, const SaveOptions& options, Progress& progress,
+					   std::vector<format::RowEntry>& table, uint64_t& tableOffset ) const;
+
+	/* for each row the first row with the same min() and values as it, 
+		itself if there is none or options.dedup is off */
+	std::vector<size_t> duplicate_rows( const SaveOptions& options ) const;
+
+	/* an empty row using the matrix allocator, new rows are copies of it */
+	Row empty_row() const { return Row( defaultValue, get_allocator() ); }
+
+	/* row that the next compact() call starts from */
+	size_t compactRow = 0;
+
+	/* rows changed since track_changes() or the last save_delta(),
+		lastChange saves a lookup for repeated changes to the same row */
+	bool tracking = false;
+	std::unordered_set<size_t> changes;
+	size_t lastChange = -1;
+
+	void mark( const size_t row )
+	{
+		if( !tracking || row == lastChange ) return;
+
+		changes.insert( row );
+		lastChange = row;
+	}
+
+	/* get_row() without marking the row as changed */
+	Row& make_row( size_t row );
+
+	/* replace rows with the ones in the delta file filename, returns true if error */
+	bool apply_delta( std::string filename );
+
+	/* size up the allocator for loading rows rows of total values */
+	void reserve_load( const size_t rows, const size_t total );
+
 public:
-	using std::vector< OffsetVector<T> >::begin;
-	using std::vector< OffsetVector<T> >::const_iterator;
-	using std::vector< OffsetVector<T> >::end;
-	using std::vector< OffsetVector<T> >::empty;
-	using std::vector< OffsetVector<T> >::iterator;
-	using std::vector< OffsetVector<T> >::resize;
-	using std::vector< OffsetVector<T> >::size;
+	using Rows::begin;
+	using Rows::const_iterator;
+	using Rows::end;
+	using Rows::empty;
+	using Rows::iterator;
+	using Rows::resize;
+	using Rows::size;
+
+	using Rows::front_capacity;
+	using Rows::back_capacity;
 
 	T defaultValue = 0;
 
-	OffsetMatrix( const T& defaultValue ) : defaultValue(defaultValue) {}
+	OffsetMatrix( const T& defaultValue, const allocator_type& alloc=allocator_type() ) : 
+		Rows( alloc ), defaultValue(defaultValue) {}
+
+	// copy constructor
+	OffsetMatrix( const OffsetMatrix<T, RowType>& other ) = default;
+
+	// move constructor, rows are moved rather than copied, along with any tracked changes
+	OffsetMatrix( OffsetMatrix<T, RowType>&& other ) noexcept :
+		Rows( std::move(other) ), mn( other.mn ), tracking( other.tracking ), changes( std::move(other.changes) ),
+		lastChange( other.lastChange ), defaultValue( std::move(other.defaultValue) )
+	{
+		other.mn = 0;
+		other.tracking = false;
+		other.clear_changes();
+	}
+
+	// copy assignment
+	OffsetMatrix<T, RowType>& operator=( const OffsetMatrix<T, RowType>& other ) = default;
+
+	// move assignment
+	OffsetMatrix<T, RowType>& operator=( OffsetMatrix<T, RowType>&& other ) noexcept
+	{
+		Rows::operator=( std::move(other) );
+		mn = other.mn;
+		tracking = other.tracking;
+		changes = std::move(other.changes);
+		lastChange = other.lastChange;
+		defaultValue = std::move(other.defaultValue);
+		other.mn = 0;
+		other.tracking = false;
+		other.clear_changes();
+		return *this;
+	}
+
+	/* the allocator every row is created with */
+	allocator_type get_allocator() const { return allocator_type( Rows::get_allocator() ); }
 
 	/* get the number of rows, the min/max row numbers from the matrix */
 	size_t min() const;
 	size_t max() const;
 	size_t values() const;
+
+	/* the memory held by the matrix, in use and allocated, see offsetstats.h.
+		walks every row. needs dense rows */
+	MemoryStats memory() const;
+
+	/* reductions over the stored values of every row, see offsetreduce.h.
+		count_not_default() is the number of values that aren't defaultValue */
 	size_t count( const T &val ) const;
+	size_t count_not( const T &val ) const;
+	size_t count_not_default() const { return count_not( defaultValue ); }
+	typename reduce::sum_type<T>::type sum() const;
+
+	/* smallest/largest stored value, defaultValue if nothing is stored */
+	T min_value() const;
+	T max_value() const;
+
+	/* find the first stored value equal to val, rows in order then columns.
+		returns true and sets row, col if there is one */
+	bool find_first( const T &val, size_t &row, size_t &col ) const;
 
 	bool clear();
 
-	//void shrink_to_fit();
+	/* make sure rows lo to hi (inclusive) can be created without 
+		reallocating the row store */
+	void reserve_rows( const size_t lo, const size_t hi );
+
+	/* trim the defaultValues from both ends of every row, drop the empty
+		rows at either end of the matrix and release spare capacity.
+
+		with a budget the pass stops once the budget has been used up and
+		the next call carries on from the row it reached, so it can be run
+		a bit at a time between other work. returns the number of rows
+		still to do, 0 once the pass is complete */
+	size_t compact( std::chrono::steady_clock::duration budget=std::chrono::steady_clock::duration::zero() );
 
 	/* set the value at row, col,
 		will resize the matrix is row, col doesn't currently exist */
-	void set( size_t row, size_t col, T val );
+	void set( size_t row, size_t col, const T& val );
+	void set( size_t row, size_t col, T&& val );
+
+	/* set row, col to T( args... ), moved into place */
+	template <typename... Args>
+	void emplace( size_t row, size_t col, Args&&... args ) { set( row, col, T( std::forward<Args>( args )... ) ); }
 
 	/* returns the value at row, col,
 		if row, col doesn't exist then will return defaultValue */
 	T get( size_t row, size_t col ) const;
 	T operator()( size_t row, size_t col ) const;
 
+	/* as get() without copying the value, the reference is to defaultValue
+		if nothing is stored at row, col. only valid until the matrix changes */
+	const T& get_ref( size_t row, size_t col ) const;
+
+	/* pointer to the value stored at row, col, 
+		nullptr if row, col doesn't exist */
+	T* find( size_t row, size_t col );
+	const T* find( size_t row, size_t col ) const;
+
+	/* no bounds checking, only use if row, col is stored. needs dense rows */
+	T& at_unchecked( size_t row, size_t col ) { return Rows::operator[]( row - mn )[ col ]; }
+	const T& at_unchecked( size_t row, size_t col ) const { return Rows::operator[]( row - mn )[ col ]; }
+
+	/* read only view of rows rowLo to rowHi and columns colLo to colHi
+		(inclusive) without copying, see offsetslice.h. needs dense rows */
+	OffsetMatrixSlice<T, Row> slice( size_t rowLo, size_t rowHi, size_t colLo, size_t colHi ) const;
+
+	/* the smallest and largest column stored in any row.
+		returns true and sets colMin, colMax if anything is stored */
+	bool column_extent( size_t &colMin, size_t &colMax ) const;
+
+	/* copy column col of rows rowLo to rowHi (inclusive) to out, 
+		defaultValue for rows where it isn't stored */
+	void get_column( size_t col, size_t rowLo, size_t rowHi, T* out ) const;
+
+	/* as above for the rows min() to max(), size() values */
+	void get_column( size_t col, T* out ) const { if( !empty() ) get_column( col, min(), max(), out ); }
+
+	/* new matrix with rows and columns swapped, row c of it holds column c
+		from the first to the last row that stores it. copied in 64 column
+		blocks, so the rows being written stay in cache, split between
+		threads threads (0 for parallel::default_threads()). needs dense rows */
+	OffsetMatrix<T, RowType> transpose( size_t threads=1 ) const;
+
+	/* every stored value, including defaultValues inside rows, as
+		OffsetMatrixEntry (row, col, value&), rows in order then columns.
+		begin()/end() stay over the rows. needs dense rows */
+	OffsetMatrixRange<element_iterator> elements() 
+		{ return OffsetMatrixRange<element_iterator>( element_iterator( begin(), end(), mn ), element_iterator() ); }
+	OffsetMatrixRange<const_element_iterator> elements() const
+		{ return OffsetMatrixRange<const_element_iterator>( const_element_iterator( begin(), end(), mn ), const_element_iterator() ); }
+
+	/* as elements(), skipping stored values equal to defaultValue */
+	OffsetMatrixRange<element_iterator> nonDefault() 
+		{ return OffsetMatrixRange<element_iterator>( element_iterator( begin(), end(), mn, &defaultValue ), element_iterator() ); }
+	OffsetMatrixRange<const_element_iterator> nonDefault() const
+		{ return OffsetMatrixRange<const_element_iterator>( const_element_iterator( begin(), end(), mn, &defaultValue ), const_element_iterator() ); }
+
+	/* out[i] = get( rows[i], cols[i] ) for i in [0, n).
+		one unsigned comparison each for the row and the column instead of
+		the min/max/empty checks of get() at both levels. needs dense rows */
+	void get_many( const size_t* rows, const size_t* cols, T* out, size_t n ) const;
+
+	/* set( rows[i], cols[i], vals[i] ) for i in [0, n), in that order,
+		except that a default value never adds a row. get() gives the same
+		values as after those set() calls, but rows that would only get
+		defaults aren't created, so min(), max() and size() can be
+		narrower. the columns of each row are counted first so every
+		row is grown once to cover all of its new columns. needs dense rows */
+	void set_many( const size_t* rows, const size_t* cols, const T* vals, size_t n );
+
 	/* writes the currect Matrix as a binary file to filename.
 		returns true if error, false if success.
 
+		format is version 2, see offsetformat.h. every row payload starts
+		on a 64 byte boundary and a row table at the end of the file gives
+		the position of each row, so single rows can be read directly */
+	bool save( std::string filename, bool verbose=false ) const;
+
+	/* as above, row payloads are gathered into options.bufferSize sized
+		writes. the position of every row is worked out up front from its 
+		size() so with options.threads > 1 ranges of rows are written by 
+		separate threads. with options.codec set rows are encoded (by
+		options.threads threads) before being written. if stats is given 
+		it is filled with the bytes written and the time taken */
+	bool save( std::string filename, const SaveOptions& options, SaveStats* stats=nullptr ) const;
+
+	/* save() on a background thread, the future holds what save() returned.
+		the rows are first copied into one block of memory, which is all
+		the caller waits for, and the copy is written while the matrix
+		carries on changing. the file is the matrix as it was at the call.
+		the thread owns the copy, so the matrix can be changed or destroyed
+		and the future dropped without waiting for the write, the future
+		is only needed to know it finished. with options.verbose progress
+		is written to options.output from the background thread */
+	std::future<bool> save_async( std::string filename, const SaveOptions& options=SaveOptions() ) const;
+
+	/* writes the currect Matrix as a binary file to filename in the 
+		original (version 1) format.
+		returns true if error, false if success.
+
 		format is:
+			[total number of values]
+			 size_t
+
 			[minimum row number]           [number of rows]
 			 size_t                         size_t
 
@@ -88,121 +445,816 @@ public:
 			[last row, 1st col value][last row, 2nd col value]...[last row, last col value]
 			 typedef T                typedef T                   typedef T	
 	*/
-	bool save( std::string filename, bool verbose=false ) const;
+	bool save_v1( std::string filename, bool verbose=false ) const;
 
-	/* load matrix from filenames, assumes file name is a pickle() created file.
+	/* load matrix from filenames, assumes file name is a save() or save_v1() 
+		created file.
 		returns true if error, false if success. 
 		will overwrite curret Matrix contents */
 	bool load( std::string filename, bool verbose=false, std::ostream& output=std::cout );
+
+	/* as above, with options.threads > 1 the rows of a version 2 file are 
+		read by separate threads using the row table */
+	bool load( std::string filename, const LoadOptions& options );
+
+	/* read only copy of the matrix with all the rows packed into one 
+		buffer, see FrozenOffsetMatrix. needs dense rows */
+	FrozenOffsetMatrix<T> freeze() const { return FrozenOffsetMatrix<T>( *this ); }
 };
 
-template <typename T>
-typename OffsetMatrix<T>::Row& OffsetMatrix<T>::get_row( const size_t row )
+template <typename T, typename RowType>
+typename OffsetMatrix<T, RowType>::Row& OffsetMatrix<T, RowType>::get_row( const size_t row )
+{
+	mark( row );
+
+	return make_row( row );
+}
+
+template <typename T, typename RowType>
+typename OffsetMatrix<T, RowType>::Row& OffsetMatrix<T, RowType>::make_row( const size_t row )
 {	
-	/* if row is greater than current max,
-		resize rows to fit and initialise the unique_ptrs */
-	if( row > max() )
-	{	
-		const size_t originalSize = size();
+	/* if is empty,
+		place the row in any space reserved by reserve_rows() otherwise
+		start again at the front of the row store */
+	if( empty() )
+	{
+		const size_t slot = row + front_capacity() - min();
+		const size_t slots = front_capacity() + back_capacity();
 
-		resize( row - min() +1 );
+		this->reset( row + front_capacity() >= min() && slot < slots ? slot : 0 );
+		resize( 1, empty_row() );
+		mn = row;
+	}
+	/* if row is greater than current max,
+		resize rows to fit */
+	else if( row > max() )
+	{
+		OFFSET_COUNT( rowsBackGrows, 1 );
+		resize( row - min() +1, empty_row() );
 	}
 	/* if row is less than the current min,
-		resize rows to fit, move contents of front of vector to 
-		the back (move() is fast and unique_ptrs safe), initialise
-		the new unique_ptrs */
+		grow the front of the row store into the headroom, 
+		this is amortized O(1) rather than moving every row */
 	else if( row < min() )
 	{
-		const size_t increase = min() - row;
-		const size_t originalSize = size();
-
-		resize( size() + increase );
-
-		std::move_backward( begin(), next(begin(),originalSize), end() );
+		OFFSET_COUNT( rowsFrontGrows, 1 );
+		this->grow_front( min() - row, empty_row() );
 		
 		mn = row;
 	}
-	/* if is empty resize to 1 and initialise the new unique_ptr */
-	else if( empty() )
-	{
-		resize(1);
-		mn = row;
-	}
 
 	// return reference to the correct Row
 	return (*this)[row - min()];
 }
 
-template <typename T>
-const typename OffsetMatrix<T>::Row& OffsetMatrix<T>::get_row( size_t row ) const
+template <typename T, typename RowType>
+const typename OffsetMatrix<T, RowType>::Row& OffsetMatrix<T, RowType>::get_row( size_t row ) const
 {
 	return (*this)[row - min()];
 }
 
-template <typename T>
-size_t OffsetMatrix<T>::min() const { return mn; }
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::min() const { return mn; }
 
-template <typename T>
-size_t OffsetMatrix<T>::max() const { return min() + size() -1; };
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::max() const { return min() + size() -1; };
 
-template <typename T>
-size_t OffsetMatrix<T>::values() const
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::values() const
 {
 	return accumulate( begin(), end(), (size_t)0, 
 		[]( size_t count, const Row &r ) { return count + r.size(); } );
 }
 
-template <typename T>
-size_t OffsetMatrix<T>::count( const T &val ) const
+template <typename T, typename RowType>
+MemoryStats OffsetMatrix<T, RowType>::memory() const
+{
+	MemoryStats m;
+	m.rows = size();
+	m.rowCapacity = front_capacity() + size() + back_capacity();
+
+	for( const Row &r : *this )
+	{
+		m.values += r.size();
+		m.capacity += r.front_capacity() + r.size() + r.back_capacity();
+		m.defaults += r.count( defaultValue );
+	}
+
+	m.headerBytes = sizeof(Row) * m.rowCapacity;
+	m.bytesUsed = sizeof(Row) * m.rows + sizeof(T) * m.values;
+	m.bytesAllocated = m.headerBytes + sizeof(T) * m.capacity;
+
+	return m;
+}
+
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::count( const T &val ) const
+{
+	size_t c = 0;
+	for( const Row &r : *this )
+		c += r.count( val );
+	
+	return c;
+}
+
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::count_not( const T &val ) const
 {
 	size_t c = 0;
 	for( const Row &r : *this )
-		c += std::count( r.begin(), r.end(), val );
+		c += r.count_not( val );
 	
 	return c;
 }
 
+template <typename T, typename RowType>
+typename reduce::sum_type<T>::type OffsetMatrix<T, RowType>::sum() const
+{
+	typename reduce::sum_type<T>::type s = 0;
+	for( const Row &r : *this )
+		s += r.sum();
+	
+	return s;
+}
+
+template <typename T, typename RowType>
+T OffsetMatrix<T, RowType>::min_value() const
+{
+	bool found = false;
+	T m = defaultValue;
+	for( const Row &r : *this )
+	{
+		if( r.empty() ) continue;
+
+		m = found ? std::min( m, r.min_value() ) : r.min_value();
+		found = true;
+	}
+
+	return m;
+}
+
+template <typename T, typename RowType>
+T OffsetMatrix<T, RowType>::max_value() const
+{
+	bool found = false;
+	T m = defaultValue;
+	for( const Row &r : *this )
+	{
+		if( r.empty() ) continue;
+
+		m = found ? std::max( m, r.max_value() ) : r.max_value();
+		found = true;
+	}
+
+	return m;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::find_first( const T &val, size_t &row, size_t &col ) const
+{
+	for( size_t i=0; i<size(); ++i )
+	{
+		const size_t c = (*this)[i].find_first( val );
+		if( c == Row::npos ) continue;
 
-template <typename T>
-bool OffsetMatrix<T>::clear()
+		row = min() + i;
+		col = c;
+		return true;
+	}
+
+	return false;
+}
+
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::clear()
 {
-	std::vector< OffsetVector<T> >::clear();
+	// every row is changed, back to empty
+	if( tracking )
+		for( size_t i=0; i<size(); ++i )
+			changes.insert( mn + i );
+
+	Rows::clear();
 	mn = 0;
+
+	return false;
+}
+
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::reserve_load( const size_t rows, const size_t total )
+{
+	/* the row store, the values and the alignment padding of each row */
+	allocator_type alloc = get_allocator();
+	reserve_allocator( alloc, sizeof(Row) * rows + sizeof(T) * total + alignof(Row) + alignof(T) * rows );
+}
+
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::reserve_rows( const size_t lo, const size_t hi )
+{
+	if( lo > hi ) return;
+
+	/* no rows yet, keep the whole range at the back of the row store
+		and remember where it starts */
+	if( empty() )
+	{
+		this->reset( 0 );
+		this->reserve_back( hi - lo +1 );
+		mn = lo;
+		return;
+	}
+
+	this->reserve( lo < min() ? min() - lo : 0, hi > max() ? hi - max() : 0 );
+}
+
+template <typename T, typename RowType>
+OffsetMatrixSlice<T, RowType> OffsetMatrix<T, RowType>::slice( size_t rowLo, size_t rowHi, size_t colLo, size_t colHi ) const
+{
+	if( empty() || rowLo > rowHi || rowHi < min() || rowLo > max() )
+		return OffsetMatrixSlice<T, Row>( rowLo, rowHi, colLo, colHi, rowLo, nullptr, 0, defaultValue );
+
+	const size_t first = std::max( rowLo, min() );
+	const size_t last = std::min( rowHi, max() );
+
+	return OffsetMatrixSlice<T, Row>( rowLo, rowHi, colLo, colHi, first, 
+									  this->data() + (first - mn), last - first +1, defaultValue );
 }
 
-/*template <typename T>
-void OffsetMatrix<T>::shrink_to_fit()
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::column_extent( size_t &colMin, size_t &colMax ) const
 {
-	rows.shrink_to_fit();
-	for_each( rows.begin(), rows.end(), []( std::unique_ptr<Row> &r ){ r->shrink_to_fit(); } );
-}*/
+	bool found = false;
+	for( const Row &r : *this )
+	{
+		if( r.empty() ) continue;
+
+		if( !found || r.min() < colMin ) colMin = r.min();
+		if( !found || r.max() > colMax ) colMax = r.max();
+		found = true;
+	}
+
+	return found;
+}
 
-template <typename T>
-void OffsetMatrix<T>::set( size_t row, size_t col, T val )
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::get_column( size_t col, size_t rowLo, size_t rowHi, T* out ) const
+{
+	if( rowLo > rowHi ) return;
+
+	if( empty() || rowHi < min() || rowLo > max() )
+	{
+		std::fill( out, out + (rowHi - rowLo +1), defaultValue );
+		return;
+	}
+
+	const size_t first = std::max( rowLo, min() );
+	const size_t last = std::min( rowHi, max() );
+
+	out = std::fill_n( out, first - rowLo, defaultValue );
+	for( size_t i=first - mn; i<=last - mn; ++i )
+		*out++ = (*this)[i].get( col, defaultValue );
+
+	std::fill_n( out, rowHi - last, defaultValue );
+}
+
+template <typename T, typename RowType>
+OffsetMatrix<T, RowType> OffsetMatrix<T, RowType>::transpose( size_t threads ) const
+{
+	OffsetMatrix<T, RowType> result( defaultValue, get_allocator() );
+
+	size_t colMin, colMax;
+	if( !column_extent( colMin, colMax ) ) return result;
+
+	if( threads == 0 ) threads = parallel::default_threads();
+
+	/* the first and last row storing each column, the extent of each new row */
+	const size_t cols = colMax - colMin +1;
+	const size_t none = -1;
+	std::vector<size_t> lo( cols, none ), hi( cols, 0 );
+	size_t total = 0;
+	for( size_t i=0; i<size(); ++i )
+	{
+		const Row &r = (*this)[i];
+		if( r.empty() ) continue;
+
+		for( size_t c=r.min() - colMin; c<r.min() - colMin + r.size(); ++c )
+		{
+			if( lo[c] == none ) lo[c] = i;
+			hi[c] = i;
+		}
+	}
+
+	for( size_t c=0; c<cols; ++c )
+		if( lo[c] != none ) total += hi[c] - lo[c] +1;
+
+	/* every row and value in one go, as load() */
+	allocator_type alloc = result.get_allocator();
+	reserve_allocator( alloc, sizeof(Row) * cols + sizeof(T) * total + alignof(Row) + alignof(T) * cols );
+	result.reserve_rows( colMin, colMax );
+	result.get_row( colMin );
+	result.get_row( colMax );
+
+	auto rows = result.begin();
+	for( size_t c=0; c<cols; ++c )
+		if( lo[c] != none ) rows[c] = Row( min() + lo[c], hi[c] - lo[c] +1, defaultValue, alloc );
+
+	/* each task copies a block of columns down every row, reading a short
+		run from each row and writing the next value of each of the block's
+		new rows, so both sides stay in cache. tasks write different rows */
+	const size_t block = 64;
+	parallel::for_each_index( (cols + block -1) / block, threads, [&]( size_t k )
+	{
+		const size_t c0 = colMin + k * block;
+		const size_t c1 = std::min( c0 + block -1, colMax );
+
+		for( size_t i=0; i<size(); ++i )
+		{
+			const Row &r = (*this)[i];
+			if( r.empty() || r.max() < c0 || r.min() > c1 ) continue;
+
+			const size_t from = std::max( c0, r.min() ), to = std::min( c1, r.max() );
+			const T* src = r.data() + (from - r.min());
+			for( size_t c=from; c<=to; ++c )
+				rows[c - colMin][ min() + i ] = *src++;
+		}
+	} );
+
+	return result;
+}
+
+template <typename T, typename RowType>
+size_t OffsetMatrix<T, RowType>::compact( std::chrono::steady_clock::duration budget )
+{
+	const auto deadline = std::chrono::steady_clock::now() + budget;
+	const bool limited = budget > std::chrono::steady_clock::duration::zero();
+
+	if( empty() ) return 0;
+
+	/* rows may have been added or removed since the last call,
+		at least one row is done every call so the pass always finishes */
+	for( size_t row=std::max( compactRow, min() ); row<=max(); ++row )
+	{
+		(*this)[row - mn].compact( defaultValue );
+
+		if( limited && row < max() && std::chrono::steady_clock::now() >= deadline )
+		{
+			compactRow = row +1;
+			return max() - row;
+		}
+	}
+
+	compactRow = 0;
+
+	/* drop the empty rows at either end */
+	size_t first = 0, last = size();
+	while( first != last && (*this)[first].empty() ) ++first;
+	while( last != first && (*this)[last -1].empty() ) --last;
+
+	if( first == last )
+	{
+		Rows::clear();
+		mn = 0;
+	}
+	else
+	{
+		resize( last, empty_row() );
+		this->erase_front( first );
+		mn += first;
+	}
+
+	this->shrink_to_fit();
+
+	return 0;
+}
+
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::set( size_t row, size_t col, const T& val )
 {
 	Row &r = get_row( row );
 	r.set( col, val, defaultValue );	
 }
 
-template <typename T>
-T OffsetMatrix<T>::get( size_t row, size_t col ) const 
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::set( size_t row, size_t col, T&& val )
+{
+	Row &r = get_row( row );
+	r.set( col, std::move( val ), defaultValue );	
+}
+
+template <typename T, typename RowType>
+const T& OffsetMatrix<T, RowType>::get_ref( size_t row, size_t col ) const
+{
+	const T* val = find( row, col );
+
+	return val ? *val : defaultValue;
+}
+
+template <typename T, typename RowType>
+T* OffsetMatrix<T, RowType>::find( size_t row, size_t col )
+{
+	if( row < min() || row > max() || empty() )
+		return nullptr;
+
+	mark( row );
+
+	return (*this)[row - min()].find( col );
+}
+
+template <typename T, typename RowType>
+const T* OffsetMatrix<T, RowType>::find( size_t row, size_t col ) const
+{
+	if( row < min() || row > max() || empty() )
+		return nullptr;
+
+	return get_row( row ).find( col );
+}
+
+template <typename T, typename RowType>
+T OffsetMatrix<T, RowType>::get( size_t row, size_t col ) const 
 {
 	if( row < min() || row > max() || empty() )
 		return defaultValue;
 	
 	const Row &r = get_row( row );
-	return r.get( col );
+	return r.get( col, defaultValue );
+}
+
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::get_many( const size_t* rows, const size_t* cols, T* out, size_t n ) const
+{
+	// kept in locals, a store to out could alias them when T is a char type
+	const size_t rowsMin = min(), rowsNum = size();
+	const Row* const rowsData = rowsNum > 0 ? &(*this)[0] : nullptr;
+
+	for( size_t i=0; i<n; ++i )
+	{
+		// row < min() wraps around, so one comparison covers both ends
+		if( rows[i] - rowsMin >= rowsNum )
+		{
+			out[i] = defaultValue;
+			continue;
+		}
+
+		const Row &r = rowsData[rows[i] - rowsMin];
+		const size_t c = cols[i] - r.min();
+		out[i] = c < r.size() ? r.data()[c] : defaultValue;
+	}
+}
+
+template <typename T, typename RowType>
+void OffsetMatrix<T, RowType>::set_many( const size_t* rows, const size_t* cols, const T* vals, size_t n )
+{
+	size_t lo = -1, hi = 0;
+	for( size_t i=0; i<n; ++i )
+	{
+		lo = std::min( lo, rows[i] );
+		hi = std::max( hi, rows[i] );
+	}
+
+	/* the first and last column each row stores and which value goes
+		there. not when the rows are spread wider than there are values,
+		the ranges would cost more than the sets */
+	if( n > 0 && hi - lo < n )
+	{
+		struct Ends { size_t lo = -1, hi = 0, first = 0, last = 0; };
+		std::vector<Ends> ends( hi - lo +1 );
+		for( size_t i=0; i<n; ++i )
+		{
+			if( vals[i] == defaultValue ) continue;
+
+			Ends &e = ends[ rows[i] - lo ];
+			if( cols[i] < e.lo ) { e.lo = cols[i]; e.first = i; }
+			if( cols[i] >= e.hi ) { e.hi = cols[i]; e.last = i; }
+		}
+
+		/* grow the row store and then every row once, setting both ends
+			so every column in between has a slot. the values are all set
+			again below in order, so the last write to a column still wins.
+			rows with nothing but default values aren't added */
+		size_t first = -1, last = 0;
+		for( size_t row=lo; row<=hi; ++row )
+		{
+			if( ends[row - lo].lo > ends[row - lo].hi ) continue;
+
+			first = std::min( first, row );
+			last = row;
+		}
+
+		if( first <= last )
+		{
+			make_row( first );
+			make_row( last );
+		}
+
+		for( size_t row=first; row<=last; ++row )
+		{
+			const Ends &e = ends[row - lo];
+			if( e.lo > e.hi ) continue;
+
+			Row &r = (*this)[row - min()];
+			r.reserve_range( e.lo, e.hi );
+			r.set( e.lo, vals[e.first], defaultValue );
+			r.set( e.hi, vals[e.last], defaultValue );
+		}
+
+		// only default values fall outside the stored columns now
+		const size_t rowsMin = min(), rowsNum = size();
+		Row* const rowsData = rowsNum > 0 ? &(*this)[0] : nullptr;
+		const bool track = tracking;
+		for( size_t i=0; i<n; ++i )
+		{
+			if( rows[i] - rowsMin >= rowsNum ) continue;
+
+			Row &r = rowsData[rows[i] - rowsMin];
+			const size_t c = cols[i] - r.min();
+			if( c >= r.size() ) continue;
+
+			if( track ) mark( rows[i] );
+			r.data()[c] = vals[i];
+		}
+
+		return;
+	}
+
+	for( size_t i=0; i<n; ++i )
+	{
+		if( vals[i] == defaultValue && rows[i] - min() >= size() ) continue;
+
+		get_row( rows[i] ).set( cols[i], vals[i], defaultValue );
+	}
 }
 
-template <typename T>
-T OffsetMatrix<T>::operator()( size_t row, size_t col ) const
+template <typename T, typename RowType>
+T OffsetMatrix<T, RowType>::operator()( size_t row, size_t col ) const
 {
 	return get( row, col );
 }
 
-template <typename T>
-bool OffsetMatrix<T>::save( std::string filename, bool verbose ) const
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save( std::string filename, bool verbose ) const
+{
+	SaveOptions options;
+	options.verbose = verbose;
+
+	return save( filename, options );
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save( std::string filename, const SaveOptions& options, SaveStats* stats ) const
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
+	OFFSET_TIME( save );
+	const auto start = std::chrono::steady_clock::now();
+
+	const int fd = open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd < 0 ) return true;
+
+	std::vector<format::RowEntry> table( size() );
+	uint64_t tableOffset;
+
+	Progress progress( options, size() );
+
+	bool failed = options.codec == format::RAW ? 
+					save_raw( fd, options, progress, table, tableOffset ) :
+					save_encoded( fd, options, progress, table, tableOffset );
+
+	if( format::pwrite_all( fd, table.data(), sizeof(format::RowEntry) * table.size(), tableOffset ) ) 
+		failed = true;
+
+	const format::Header header = format::make_header<T>( values(), min(), size(), tableOffset );
+	if( format::pwrite_all( fd, &header, sizeof(header), 0 ) ) failed = true;
+	if( close( fd ) != 0 ) failed = true;
+
+	// deltas taken against whatever was here before don't apply to this
+	if( !failed && format::remove_manifest( filename ) ) failed = true;
+
+	progress.finish();
+
+	if( stats )
+	{
+		stats->bytes = tableOffset + sizeof(format::RowEntry) * table.size();
+		stats->seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+	return failed;
+}
+
+template <typename T, typename RowType>
+std::future<bool> OffsetMatrix<T, RowType>::save_async( std::string filename, const SaveOptions& options ) const
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
+	typedef OffsetMatrix<T, OffsetVector<T, ArenaAllocator<T> > > Copy;
+	typedef typename Copy::Row CopyRow;
+
+	/* the copy and the arena it lives in, freed together once it is written */
+	struct Snapshot
+	{
+		Arena arena;
+		Copy matrix;
+
+		Snapshot( const T& defaultValue ) : arena( 64 ), matrix( defaultValue, arena ) {}
+	};
+
+	std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>( defaultValue );
+	if( !empty() )
+	{
+		Copy &copy = snapshot->matrix;
+		typename Copy::allocator_type alloc = copy.get_allocator();
+
+		/* every row and value in one block, as load() */
+		reserve_allocator( alloc, sizeof(CopyRow) * size() + sizeof(T) * values() + alignof(CopyRow) + alignof(T) * size() );
+		copy.reserve_rows( min(), max() );
+		copy.get_row( min() );
+		copy.get_row( max() );
+
+		auto rows = copy.begin();
+		for( size_t i=0; i<size(); ++i )
+		{
+			const Row &r = (*this)[i];
+			if( !r.empty() ) rows[i] = CopyRow( r.min(), r.begin(), r.end(), defaultValue, alloc );
+		}
+	}
+
+	/* a detached thread rather than std::async, whose future would wait
+		for the write when destroyed */
+	std::shared_ptr< std::promise<bool> > saved = std::make_shared< std::promise<bool> >();
+	std::future<bool> result = saved->get_future();
+
+	std::thread( [snapshot, saved, filename, options]()
+	{
+		saved->set_value( snapshot->matrix.save( filename, options ) );
+	} ).detach();
+
+	return result;
+}
+
+template <typename T, typename RowType>
+std::vector<size_t> OffsetMatrix<T, RowType>::duplicate_rows( const SaveOptions& options ) const
+{
+	if( options.dedup )
+		return format::find_duplicates<T>( size(), [this]( size_t i ) { return &(*this)[i]; } );
+
+	std::vector<size_t> first( size() );
+	for( size_t i=0; i<size(); ++i )
+		first[i] = i;
+
+	return first;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save_raw( const int fd, const SaveOptions& options, Progress& progress,
+								std::vector<format::RowEntry>& table, uint64_t& tableOffset ) const
+{
+	const std::vector<size_t> first = duplicate_rows( options );
+
+	// work out where every row goes before writing anything
+	uint64_t pos = sizeof(format::Header);
+	for( size_t i=0; i<size(); ++i )
+	{
+		// a repeated row points at the payload of the first one
+		if( first[i] != i )
+		{
+			table[i] = table[ first[i] ];
+			continue;
+		}
+
+		const Row &r = (*this)[i];
+
+		format::RowEntry &entry = table[i];
+		entry.colsMin = r.min();
+		entry.colsNum = r.size();
+		entry.offset = format::align( pos );
+		entry.bytes = sizeof(T) * r.size();
+		entry.codec = format::RAW;
+
+		pos = entry.offset + entry.bytes;
+	}
+
+	tableOffset = format::align( pos );
+
+	// split the rows into chunks of similar size, more chunks than threads so they balance
+	const size_t threads = options.threads == 0 ? parallel::default_threads() : options.threads;
+	const std::vector<size_t> chunks = parallel::split( size(), threads > 1 ? threads*4 : 1, 
+		[&]( size_t i ) { return first[i] == i ? table[i].bytes + format::alignment : 0; } );
+
+	std::mutex mutex;
+	std::atomic<bool> failed( false );
+
+	parallel::for_each_index( chunks.size() -1, threads, [&]( size_t chunk )
+	{
+		const size_t last = chunks[chunk+1];
+		if( chunks[chunk] == last ) return;
+
+		// the writer starts at the first payload the chunk writes itself, if any
+		size_t start = chunks[chunk];
+		while( start != last && first[start] != start ) ++start;
+
+		format::Writer file( fd, start != last ? table[start].offset : 0, options.bufferSize );
+
+		// write all the column values as contiguous, aligned blocks
+		for( size_t i=chunks[chunk]; i<last; ++i )
+		{
+			if( first[i] == i )
+			{
+				file.pad( table[i].offset );
+				file.write( (*this)[i].data(), table[i].bytes );
+			}
+
+			if( threads == 1 ) progress.step();
+		}
+
+		if( file.flush() ) failed = true;
+
+		if( threads > 1 )
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			progress.step( last - chunks[chunk] );
+		}
+	} );
+
+	return failed;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save_encoded( const int fd, const SaveOptions& options, Progress& progress,
+									std::vector<format::RowEntry>& table, uint64_t& tableOffset ) const
+{
+	const size_t threads = options.threads == 0 ? parallel::default_threads() : options.threads;
+
+	/* split the rows into chunks of about options.bufferSize, a batch of one 
+		chunk per thread is encoded in parallel then written out in order */
+	const size_t raw = sizeof(T) * values();
+	const size_t parts = std::max( threads, raw / std::max( options.bufferSize, (size_t)1 ) +1 );
+	const std::vector<size_t> chunks = parallel::split( size(), parts, 
+		[this]( size_t i ) { return sizeof(T) * (*this)[i].size() + format::alignment; } );
+
+	const std::vector<size_t> first = duplicate_rows( options );
+
+	std::vector< std::vector<char> > buffers( threads );
+	uint64_t pos = sizeof(format::Header);
+	bool failed = false;
+
+	for( size_t batch=0; batch+1 < chunks.size(); batch += threads )
+	{
+		const size_t n = std::min( threads, chunks.size() -1 - batch );
+
+		parallel::for_each_index( n, threads, [&]( size_t k )
+		{
+			std::vector<char> &buffer = buffers[k], encoded;
+			buffer.clear();
+
+			for( size_t i=chunks[batch+k]; i<chunks[batch+k+1]; ++i )
+			{
+				if( first[i] != i ) continue;
+
+				const Row &r = (*this)[i];
+
+				format::RowEntry &entry = table[i];
+				entry.colsMin = r.min();
+				entry.colsNum = r.size();
+				entry.codec = format::encode( options.codec, r.data(), r.size(), defaultValue, encoded, options.level );
+
+				// offsets are relative to the start of the chunk until it is placed
+				buffer.resize( format::align( buffer.size() ) );
+				entry.offset = buffer.size();
+
+				const char* data = entry.codec == format::RAW ? (const char*)r.data() : encoded.data();
+				entry.bytes = entry.codec == format::RAW ? sizeof(T) * r.size() : encoded.size();
+				buffer.insert( buffer.end(), data, data + entry.bytes );
+			}
+		} );
+
+		// place the encoded chunks one after the other
+		for( size_t k=0; k<n; ++k )
+		{
+			pos = format::align( pos );
+			for( size_t i=chunks[batch+k]; i<chunks[batch+k+1]; ++i )
+			{
+				// a repeated row points at the payload of the first one, placed by now
+				if( first[i] != i )
+					table[i] = table[ first[i] ];
+				else
+					table[i].offset += pos;
+			}
+
+			failed |= format::pwrite_all( fd, buffers[k].data(), buffers[k].size(), pos );
+			pos += buffers[k].size();
+
+			progress.step( chunks[batch+k+1] - chunks[batch+k] );
+		}
+	}
+
+	tableOffset = format::align( pos );
+
+	return failed;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save_v1( std::string filename, bool verbose ) const
 {
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
 	std::ofstream file( filename, std::ios::binary );
 	if( !file.good() ) return true;
 
@@ -241,37 +1293,259 @@ bool OffsetMatrix<T>::save( std::string filename, bool verbose ) const
 
 	file.close();
 	
+	return format::remove_manifest( filename );
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::save_delta( std::string base, std::string filename )
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
+	if( !tracking ) return true;
+
+	std::vector<size_t> rows( changes.begin(), changes.end() );
+	std::sort( rows.begin(), rows.end() );
+
+	const int fd = open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd < 0 ) return true;
+
+	// value initialised, so the entries of removed rows are all zero
+	std::vector<format::DeltaEntry> table( rows.size() );
+
+	format::Writer file( fd, sizeof(format::Header), SaveOptions().bufferSize );
+	uint64_t total = 0;
+	for( size_t i=0; i<rows.size(); ++i )
+	{
+		format::DeltaEntry &delta = table[i];
+		delta.row = rows[i];
+
+		// rows that are no longer in the matrix are saved empty
+		if( empty() || rows[i] < min() || rows[i] > max() ) continue;
+
+		const Row &r = (*this)[ rows[i] - min() ];
+		delta.entry.colsMin = r.min();
+		delta.entry.colsNum = r.size();
+		delta.entry.offset = format::align( file.position() );
+		delta.entry.bytes = sizeof(T) * r.size();
+		delta.entry.codec = format::RAW;
+
+		file.pad( delta.entry.offset );
+		file.write( r.data(), delta.entry.bytes );
+		total += r.size();
+	}
+
+	const uint64_t tableOffset = format::align( file.position() );
+	file.pad( tableOffset );
+	file.write( table.data(), sizeof(format::DeltaEntry) * table.size() );
+	bool failed = file.flush();
+
+	format::Header header = format::make_header<T>( total, min(), size(), tableOffset );
+	memcpy( header.magic, format::delta_magic(), format::magicSize );
+	header.tableRows = table.size();
+
+	if( format::pwrite_all( fd, &header, sizeof(header), 0 ) ) failed = true;
+	if( close( fd ) != 0 ) failed = true;
+
+	if( failed || format::append_manifest( base, filename ) ) return true;
+
+	clear_changes();
+
+	return false;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::apply_delta( std::string filename )
+{
+	const int fd = open( filename.c_str(), O_RDONLY );
+	if( fd < 0 ) return true;
+
+	format::Header header;
+	std::vector<format::DeltaEntry> table;
+	if( format::read_delta_index<T>( fd, header, table ) )
+	{
+		close( fd );
+		return true;
+	}
+
+	/* only the rows of the matrix when the delta was saved are kept */
+	const size_t lo = header.rowsMin, hi = header.rowsMin + header.rowsNum -1;
+	if( header.rowsNum == 0 || empty() || max() < lo || min() > hi )
+	{
+		Rows::clear();
+		mn = 0;
+	}
+	else if( min() < lo || max() > hi )
+	{
+		if( max() > hi ) resize( hi - min() +1, empty_row() );
+
+		const size_t front = min() < lo ? lo - min() : 0;
+		this->erase_front( front );
+		mn += front;
+
+		// without the spare rows either side of what is left
+		this->shrink_to_fit();
+	}
+
+	if( header.rowsNum > 0 )
+	{
+		make_row( lo );
+		make_row( hi );
+	}
+
+	bool failed = false;
+	const allocator_type alloc = get_allocator();
+	std::vector<char> scratch;
+	for( size_t i=0; i<table.size() && !failed; ++i )
+	{
+		// removed rows come back empty, anything outside the matrix is gone already
+		const format::RowEntry &entry = table[i].entry;
+		if( header.rowsNum == 0 || table[i].row < lo || table[i].row > hi ) continue;
+
+		Row &r = (*this)[table[i].row - lo];
+		if( entry.colsNum == 0 )
+		{
+			r = empty_row();
+			continue;
+		}
+
+		r = Row( entry.colsMin, entry.colsNum, defaultValue, alloc );
+		if( format::read_row( fd, entry, r.data(), scratch ) ) failed = true;
+	}
+
+	if( close( fd ) != 0 ) failed = true;
+
+	return failed;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::load_chain( std::string base )
+{
+	std::vector<std::string> deltas;
+	if( load( base ) || format::read_manifest( base, deltas ) ) return true;
+
+	for( const std::string &delta : deltas )
+		if( apply_delta( delta ) ) return true;
+
+	clear_changes();
+
 	return false;
 }
 
-template <typename T>
-bool OffsetMatrix<T>::load( std::string filename, bool verbose, std::ostream& output )
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::compact_chain( std::string base )
 {
+	std::vector<std::string> deltas;
+	if( load_chain( base ) || format::read_manifest( base, deltas ) ) return true;
+
+	/* save next to the old base then swap them over, 
+		so that if anything goes wrong the chain is left as it was */
+	const std::string next = base + ".next";
+	if( save( next ) || std::rename( next.c_str(), base.c_str() ) != 0 )
+	{
+		std::remove( next.c_str() );
+		return true;
+	}
+
+	bool failed = format::remove_manifest( base );
+	for( const std::string &delta : deltas )
+		if( std::remove( delta.c_str() ) != 0 ) failed = true;
+
+	return failed;
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::load( std::string filename, bool verbose, std::ostream& output )
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
+	OFFSET_TIME( load );
+
 	std::ifstream file( filename, std::ios::binary );
 	if( !file.good() ) return true;
 
 	clear(); // make sure the matrix is empty first
-	
+	clear_changes();
+
+	// version 2 files start with a header, version 1 files with the total
+	format::Header header;
+	file.read( (char*)&header, sizeof(header) );
+	const bool v2 = format::is_v2( header.magic, file.gcount() );
+
 	// read the minimum row number and the number of rows
 	size_t total, rowsMin, rowsNum;
-	file.read( (char*)&total, sizeof(total) );
-	file.read( (char*)&rowsMin, sizeof(rowsMin) );
-	file.read( (char*)&rowsNum, sizeof(rowsNum) );
+	std::vector<format::RowEntry> table;
+
+	if( v2 )
+	{
+		if( format::check_header<T>( header ) ) return true;
 
-	get_row( rowsMin );
-	get_row( rowsMin + rowsNum -1 );
+		total = header.total;
+		rowsMin = header.rowsMin;
+		rowsNum = header.rowsNum;
 
-	auto read_row = [&file]( Row &r, T &defaultValue )
+		table.resize( rowsNum );
+		file.seekg( header.tableOffset );
+		file.read( (char*)table.data(), sizeof(format::RowEntry) * table.size() );
+	}
+	else
+	{
+		file.clear();
+		file.seekg( 0 );
+
+		file.read( (char*)&total, sizeof(total) );
+		file.read( (char*)&rowsMin, sizeof(rowsMin) );
+		file.read( (char*)&rowsNum, sizeof(rowsNum) );
+	}
+
+	if( !file.good() ) return true;
+	if( rowsNum == 0 ) return false;
+
+	reserve_load( rowsNum, total );
+	reserve_rows( rowsMin, rowsMin + rowsNum -1 );
+	make_row( rowsMin );
+	make_row( rowsMin + rowsNum -1 );
+
+	auto entry = table.begin();
+	std::vector<char> scratch;
+	const allocator_type alloc = get_allocator();
+	auto read_row = [&file, &entry, &scratch, &alloc, v2]( Row &r, T &defaultValue )
 	{
 		// read the minimum column number and the number of columns
-		size_t colsMin, colsNum;
-		file.read( (char*)&colsMin, sizeof(colsMin) );
-		file.read( (char*)&colsNum, sizeof(colsNum) );
+		size_t colsMin, colsNum, bytes;
+		format::Codec codec = format::RAW;
+		if( v2 )
+		{
+			colsMin = entry->colsMin;
+			colsNum = entry->colsNum;
+			bytes = entry->bytes;
+			codec = static_cast<format::Codec>( entry->codec );
+			file.seekg( (entry++)->offset );
+		}
+		else
+		{
+			file.read( (char*)&colsMin, sizeof(colsMin) );
+			file.read( (char*)&colsNum, sizeof(colsNum) );
+			bytes = sizeof(T)*colsNum;
+		}
+
+		if( !file.good() ) return (size_t)0;
 
-		r.set( colsMin, defaultValue ); // easiest way to set the min value
-		r.resize( colsNum, defaultValue );
+		r = Row( colsMin, colsNum, defaultValue, alloc );
 
-		file.read( (char*)r.data(), sizeof(T)*colsNum );
+		if( codec == format::RAW )
+		{
+			if( bytes != sizeof(T)*colsNum ) file.setstate( std::ios::failbit );
+			file.read( (char*)r.data(), bytes );
+		}
+		else
+		{
+			// encoded rows are read whole then decoded into the row
+			scratch.resize( bytes );
+			file.read( scratch.data(), bytes );
+
+			if( file.good() && format::decode( codec, scratch.data(), bytes, r.data(), colsNum ) )
+				file.setstate( std::ios::failbit );
+		}
 
 		return colsNum;
 	};
@@ -281,6 +1555,7 @@ bool OffsetMatrix<T>::load( std::string filename, bool verbose, std::ostream& ou
 #if defined(BOOST)
 		boost::progress_display show_progress( total, output );
 #else
+		(void)output;
 		size_t show_progress = 0;
 #endif
 		for( Row &r : *this )
@@ -292,11 +1567,77 @@ bool OffsetMatrix<T>::load( std::string filename, bool verbose, std::ostream& ou
 
 	//assert( values() == total );
 
-	return false;
+	return file.fail();
+}
+
+template <typename T, typename RowType>
+bool OffsetMatrix<T, RowType>::load( std::string filename, const LoadOptions& options )
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are saved and loaded as raw bytes" );
+
+	const size_t threads = options.threads == 0 ? parallel::default_threads() : options.threads;
+	if( threads == 1 )
+		return load( filename, options.verbose, *options.output );
+
+	const int fd = open( filename.c_str(), O_RDONLY );
+	if( fd < 0 ) return true;
+
+	/* only version 2 files have a row table to split the work with */
+	format::Header header;
+	std::vector<format::RowEntry> table;
+	if( format::read_index<T>( fd, header, table ) )
+	{
+		close( fd );
+		return load( filename, options.verbose, *options.output );
+	}
+
+	// after the fallback, which times itself
+	OFFSET_TIME( load );
+
+	clear(); // make sure the matrix is empty first
+	clear_changes();
+
+	if( header.rowsNum > 0 )
+	{
+		reserve_load( header.rowsNum, header.total );
+		reserve_rows( header.rowsMin, header.rowsMin + header.rowsNum -1 );
+		make_row( header.rowsMin );
+		make_row( header.rowsMin + header.rowsNum -1 );
+	}
+
+	const std::vector<size_t> chunks = parallel::split( size(), threads*4, 
+		[&table]( size_t i ) { return table[i].bytes + format::alignment; } );
+
+	Progress progress( options.verbose ? options.output : nullptr, size(), 0, 250 );
+	std::mutex mutex;
+	std::atomic<bool> failed( false );
+	const allocator_type alloc = get_allocator();
+
+	parallel::for_each_index( chunks.size() -1, threads, [&]( size_t chunk )
+	{
+		std::vector<char> scratch;
+		for( size_t i=chunks[chunk]; i<chunks[chunk+1] && !failed; ++i )
+		{
+			const format::RowEntry &entry = table[i];
+			Row &r = (*this)[i];
+
+			r = Row( entry.colsMin, entry.colsNum, defaultValue, alloc );
+			if( format::read_row( fd, entry, r.data(), scratch ) ) failed = true;
+		}
+
+		std::lock_guard<std::mutex> lock( mutex );
+		progress.step( chunks[chunk+1] - chunks[chunk] );
+	} );
+
+	progress.finish();
+
+	if( close( fd ) != 0 ) failed = true;
+
+	return failed;
 }
 
-template <typename T>
-std::ostream &operator<<( std::ostream &output, const OffsetMatrix<T> &m )
+template <typename T, typename RowType>
+std::ostream &operator<<( std::ostream &output, const OffsetMatrix<T, RowType> &m )
 {
 	output << "matrix: " << std::endl;
 
@@ -304,7 +1645,7 @@ std::ostream &operator<<( std::ostream &output, const OffsetMatrix<T> &m )
 
 	for( size_t row=m.min(); row<=m.max(); ++row )
 	{
-		const typename OffsetMatrix<T>::Row &r = m.get_row(row);
+		const typename OffsetMatrix<T, RowType>::Row &r = m.get_row(row);
 
 		output << std::setw(2) << row << " (" << r.size() << "): ";
 
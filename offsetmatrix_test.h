@@ -1,5 +1,12 @@
 #include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "offsetmatrix.h"
+#include "offsetsparsevector.h"
+#include "offsettest.h"
 
 using namespace offset;
 
@@ -9,6 +16,18 @@ private:
 	std::vector<int> testValues;
 	size_t startingCol;
 	int defaultValue;
+	std::string filename;
+
+	void compare( const OffsetMatrix<int> &a, const OffsetMatrix<int> &b )
+	{
+		TS_ASSERT_EQUALS( a.min(), b.min() );
+		TS_ASSERT_EQUALS( a.max(), b.max() );
+		TS_ASSERT_EQUALS( a.values(), b.values() );
+
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( a.get(row, col), b.get(row, col) );
+	}
 
 public:
 	void setUp()
@@ -16,11 +35,12 @@ public:
 		testValues = {1,2,3,4,5,6,99};
 		startingCol = 42;
 		defaultValue = 999;
+		filename = "offsetmatrix_test.bin";
 	}
 
 	void tearDown()
 	{
-
+		remove( filename.c_str() );
 	}
 
 	void test_test()
@@ -35,6 +55,775 @@ public:
 		TS_ASSERT( store.empty() );
 	}
 
+	void test_set()
+	{
+		OffsetMatrix<int> store( defaultValue );
+
+		store.set( 10, startingCol, 1 );
+		store.set( 5, startingCol+1, 2 );
+		store.set( 20, startingCol-1, 3 );
+
+		TS_ASSERT_EQUALS( 5, store.min() );
+		TS_ASSERT_EQUALS( 20, store.max() );
+
+		TS_ASSERT_EQUALS( 1, store.get(10, startingCol) );
+		TS_ASSERT_EQUALS( 2, store.get(5, startingCol+1) );
+		TS_ASSERT_EQUALS( 3, store.get(20, startingCol-1) );
+
+		TS_ASSERT_EQUALS( defaultValue, store.get(10, startingCol+1) );
+		TS_ASSERT_EQUALS( defaultValue, store.get(4, startingCol) );
+		TS_ASSERT_EQUALS( defaultValue, store.get(15, startingCol) );
+	}
+
+	void test_sparse_rows()
+	{
+		OffsetMatrix< int, OffsetSparseVector<int> > store( defaultValue );
+
+		store.set( 10, 10, 1 );
+		store.set( 10, 10000000, 2 );
+		store.set( 5, 3, 3 );
+
+		TS_ASSERT_EQUALS( 3, store.values() );
+		TS_ASSERT_EQUALS( 1, store.count( 2 ) );
+		TS_ASSERT_EQUALS( 2, store.get_row( 10 ).runs().size() );
+
+		TS_ASSERT_EQUALS( 1, store.get(10, 10) );
+		TS_ASSERT_EQUALS( 2, store.get(10, 10000000) );
+		TS_ASSERT_EQUALS( 3, store.get(5, 3) );
+		TS_ASSERT_EQUALS( defaultValue, store.get(10, 5000) );
+		TS_ASSERT_EQUALS( defaultValue, store.get(7, 3) );
+	}
+
+	void test_get_row_reverse()
+	{
+		const size_t rows = 1000;
+
+		OffsetMatrix<int> store( defaultValue );
+
+		// fill bottom to top, each row grows the front of the row store
+		for( size_t row=rows; row-->0; )
+		{
+			store.set( row, startingCol, (int)row*2 );
+			TS_ASSERT_EQUALS( row, store.min() );
+		}
+
+		TS_ASSERT_EQUALS( rows, store.size() );
+
+		for( size_t row=0; row<rows; ++row )
+			TS_ASSERT_EQUALS( (int)row*2, store.get(row, startingCol) );
+	}
+
+	void test_reserve_rows()
+	{
+		const size_t lo = 10, hi = 100;
+
+		OffsetMatrix<int> store( defaultValue );
+		store.reserve_rows( lo, hi );
+
+		TS_ASSERT( store.empty() );
+
+		store.set( 50, startingCol, 1 );
+		const OffsetMatrix<int>::Row *first = &store.get_row(50) - (50 - lo);
+
+		for( size_t row=lo; row<=hi; ++row )
+			store.set( row, startingCol, (int)row*2 );
+
+		TS_ASSERT_EQUALS( first, &store.get_row(lo) ); // no reallocation
+		TS_ASSERT_EQUALS( lo, store.min() );
+		TS_ASSERT_EQUALS( hi, store.max() );
+		for( size_t row=lo; row<=hi; ++row )
+			TS_ASSERT_EQUALS( (int)row*2, store.get(row, startingCol) );
+	}
+
+	void test_save_load()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		test::fill( a );
+
+		TS_ASSERT( !a.save( filename ) );
+		TS_ASSERT( !b.load( filename ) );
+
+		compare( a, b );
+	}
+
+	void test_save_buffered()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		test::fill( a );
+		a.set( 25, 0, 1 ); 
+		a.set( 25, 10000, 1 ); // bigger than the write buffer
+
+		std::ostringstream output;
+		SaveOptions options;
+		options.verbose = true;
+		options.output = &output;
+		options.bufferSize = 100;
+		options.progressRows = 5;
+
+		SaveStats stats;
+		TS_ASSERT( !a.save( filename, options, &stats ) );
+		TS_ASSERT( !b.load( filename ) );
+
+		compare( a, b );
+
+		TS_ASSERT_LESS_THAN( sizeof(int) * a.values(), stats.bytes );
+		TS_ASSERT_EQUALS( "5/16\r10/16\r15/16\r16/16\r\n", output.str() );
+	}
+
+	void test_save_load_parallel()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue ), c( defaultValue );
+		test::fill( a );
+		a.set( 25, 0, 1 ); 
+		a.set( 25, 10000, 1 );
+
+		SaveOptions save;
+		save.threads = 4;
+		save.bufferSize = 100;
+		TS_ASSERT( !a.save( filename, save ) );
+
+		// read back in parallel, and sequentially to check the file itself
+		LoadOptions load;
+		load.threads = 4;
+		TS_ASSERT( !b.load( filename, load ) );
+		TS_ASSERT( !c.load( filename ) );
+
+		compare( a, b );
+		compare( a, c );
+	}
+
+	void test_save_load_dedup()
+	{
+		// only four different rows, repeated
+		OffsetMatrix<int> a( defaultValue );
+		for( size_t row=0; row<40; ++row )
+			for( size_t col=5; col<25; ++col )
+				a.set( row, col, (int)((row % 4) * 100 + col) );
+		a.set( 37, 30, 1 );          // differs from 33 by one value
+		a.set( 15, 24, defaultValue ); // differs from 11 in its last value
+
+		SaveStats rawStats;
+		TS_ASSERT( !a.save( filename, SaveOptions(), &rawStats ) );
+
+		std::vector<format::Codec> codecs = { format::RAW, format::RLE };
+		for( format::Codec codec : codecs )
+			for( size_t threads=1; threads<=3; ++threads )
+			{
+				SaveOptions save;
+				save.codec = codec;
+				save.threads = threads;
+				save.bufferSize = 100;
+				save.dedup = true;
+
+				SaveStats stats;
+				TS_ASSERT( !a.save( filename, save, &stats ) );
+				TS_ASSERT_LESS_THAN( stats.bytes, rawStats.bytes / 2 );
+
+				// repeated rows point at the same payload
+				const int fd = open( filename.c_str(), O_RDONLY );
+				format::Header header;
+				std::vector<format::RowEntry> table;
+				TS_ASSERT( !format::read_index<int>( fd, header, table ) );
+				close( fd );
+				TS_ASSERT_EQUALS( table.size(), 40 );
+				TS_ASSERT_EQUALS( table[4].offset, table[0].offset );
+				TS_ASSERT_EQUALS( table[39].offset, table[3].offset );
+				TS_ASSERT_DIFFERS( table[37].offset, table[33].offset );
+				TS_ASSERT_DIFFERS( table[15].offset, table[11].offset );
+
+				OffsetMatrix<int> b( defaultValue ), c( defaultValue );
+				LoadOptions load;
+				load.threads = 2;
+				TS_ASSERT( !b.load( filename ) );
+				TS_ASSERT( !c.load( filename, load ) );
+
+				compare( a, b );
+				compare( a, c );
+				TS_ASSERT_EQUALS( b.get( 37, 30 ), 1 );
+				TS_ASSERT_EQUALS( c.get( 39, 20 ), 320 );
+			}
+	}
+
+	void test_save_load_encoded()
+	{
+		OffsetMatrix<int> a( defaultValue ), raw( defaultValue );
+		test::fill( a );
+		a.set( 25, 0, 1 ); 
+		a.set( 25, 10000, 1 ); // mostly default, worth encoding
+
+		std::vector<format::Codec> codecs = { format::RLE };
+		if( format::available( format::ZSTD ) ) codecs.push_back( format::ZSTD );
+
+		SaveStats rawStats;
+		TS_ASSERT( !a.save( filename, SaveOptions(), &rawStats ) );
+
+		for( format::Codec codec : codecs )
+			for( size_t threads=1; threads<=2; ++threads )
+			{
+				SaveOptions save;
+				save.codec = codec;
+				save.threads = threads;
+				save.bufferSize = 100;
+
+				SaveStats stats;
+				TS_ASSERT( !a.save( filename, save, &stats ) );
+				TS_ASSERT_LESS_THAN( stats.bytes, rawStats.bytes );
+
+				OffsetMatrix<int> b( defaultValue ), c( defaultValue );
+				LoadOptions load;
+				load.threads = 2;
+				TS_ASSERT( !b.load( filename ) );
+				TS_ASSERT( !c.load( filename, load ) );
+
+				compare( a, b );
+				compare( a, c );
+				TS_ASSERT_EQUALS( a.get(25, 10000), b.get(25, 10000) );
+			}
+	}
+
+	void test_load_v1()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		test::fill( a );
+
+		TS_ASSERT( !a.save_v1( filename ) );
+		TS_ASSERT( !b.load( filename ) );
+
+		compare( a, b );
+	}
+
+	void test_load_wrong_type()
+	{
+		OffsetMatrix<int> a( defaultValue );
+		OffsetMatrix<double> b( defaultValue );
+		test::fill( a );
+
+		TS_ASSERT( !a.save( filename ) );
+		TS_ASSERT( b.load( filename ) );
+	}
+
+	void test_read_row()
+	{
+		OffsetMatrix<int> a( defaultValue );
+		test::fill( a );
+		TS_ASSERT( !a.save( filename ) );
+
+		const int fd = open( filename.c_str(), O_RDONLY );
+		TS_ASSERT( fd >= 0 );
+
+		format::Header header;
+		std::vector<format::RowEntry> table;
+		TS_ASSERT( !format::read_index<int>( fd, header, table ) );
+		TS_ASSERT_EQUALS( a.size(), table.size() );
+		TS_ASSERT_EQUALS( a.min(), header.rowsMin );
+			
+		// read a single row straight from the file
+		const format::RowEntry &entry = table[15 - header.rowsMin];
+		std::vector<int> values( entry.colsNum );
+		TS_ASSERT( !format::read_row( fd, entry, values.data() ) );
+
+		for( size_t i=0; i<values.size(); ++i )
+			TS_ASSERT_EQUALS( a.get(15, entry.colsMin+i), values[i] );
+
+		close( fd );
+	}
+
+	void test_get_set_many()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		test::fill( a );
+
+		// random coordinates, some of them outside the matrix
+		std::vector<size_t> rows, cols;
+		std::vector<int> vals;
+		size_t seed = 12345;
+		for( size_t i=0; i<1000; ++i )
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			rows.push_back( (seed >> 33) % 30 );
+			cols.push_back( (seed >> 13) % 50 );
+			vals.push_back( i % 7 == 0 ? defaultValue : (int)i );
+		}
+		rows.push_back( (size_t)-1 );
+		cols.push_back( 0 );
+		vals.push_back( 1 );
+
+		std::vector<int> out( rows.size() );
+		a.get_many( rows.data(), cols.data(), out.data(), rows.size() -1 );
+		for( size_t i=0; i<rows.size() -1; ++i )
+			TS_ASSERT_EQUALS( out[i], a.get( rows[i], cols[i] ) );
+
+		// later writes to the same coordinate win, same as calling set() in turn
+		a.set_many( rows.data(), cols.data(), vals.data(), rows.size() -1 );
+		test::fill( b );
+		for( size_t i=0; i<rows.size() -1; ++i )
+			b.set( rows[i], cols[i], vals[i] );
+
+		compare( a, b );
+
+		// an empty matrix gives back defaults and ignores default values
+		OffsetMatrix<int> c( defaultValue );
+		c.get_many( rows.data(), cols.data(), out.data(), rows.size() );
+		TS_ASSERT_EQUALS( (size_t)std::count( out.begin(), out.end(), defaultValue ), out.size() );
+
+		std::vector<int> defaults( rows.size(), defaultValue );
+		c.set_many( rows.data(), cols.data(), defaults.data(), rows.size() );
+		TS_ASSERT( c.empty() );
+
+		// rows spread wider than there are values, and the same changed rows as set()
+		OffsetMatrix<int> d( defaultValue ), e( defaultValue );
+		test::fill( d );
+		test::fill( e );
+		d.track_changes();
+		e.track_changes();
+		const size_t spreadRows[] = { 1000000, 5, 1000000, 3, 40 };
+		const size_t spreadCols[] = { 7, 100, 7, 2, 0 };
+		const int spreadVals[] = { 1, 2, 3, defaultValue, defaultValue };
+		d.set_many( spreadRows, spreadCols, spreadVals, 5 );
+		for( size_t i=0; i<5; ++i )
+			e.set( spreadRows[i], spreadCols[i], spreadVals[i] );
+
+		TS_ASSERT_EQUALS( d.get( 1000000, 7 ), 3 );
+		TS_ASSERT_EQUALS( d.get( 3, 2 ), defaultValue );
+		TS_ASSERT_EQUALS( d.max(), e.max() );
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<150; ++col )
+				TS_ASSERT_EQUALS( d.get( row, col ), e.get( row, col ) );
+
+		// only rows that exist or get a value are changed
+		OffsetMatrix<int> f( defaultValue );
+		test::fill( f );
+		f.track_changes();
+		f.set_many( rows.data(), cols.data(), vals.data(), rows.size() -1 );
+		TS_ASSERT( f.changed_rows() > 0 );
+		TS_ASSERT( f.changed_rows() <= 30 );
+		compare( f, a );
+
+		// unlike set(), default values don't add rows at either end
+		OffsetMatrix<int> g( defaultValue ), h( defaultValue );
+		test::fill( g );
+		test::fill( h );
+		const size_t edgeRows[] = { 5, 25, 12 };
+		const size_t edgeCols[] = { 0, 0, 12 };
+		const int edgeVals[] = { defaultValue, defaultValue, 1 };
+		g.set_many( edgeRows, edgeCols, edgeVals, 3 );
+		for( size_t i=0; i<3; ++i )
+			h.set( edgeRows[i], edgeCols[i], edgeVals[i] );
+
+		TS_ASSERT_EQUALS( g.min(), 10 );
+		TS_ASSERT_EQUALS( g.max(), 19 );
+		TS_ASSERT_EQUALS( h.min(), 5 );
+		TS_ASSERT_EQUALS( h.max(), 25 );
+		TS_ASSERT_EQUALS( g.values(), h.values() );
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( g.get( row, col ), h.get( row, col ) );
+	}
+
+	void test_reductions()
+	{
+		OffsetMatrix<int> a( defaultValue );
+		TS_ASSERT_EQUALS( a.min_value(), defaultValue );
+		TS_ASSERT_EQUALS( a.sum(), 0 );
+
+		test::fill( a );
+		a.set( 30, 5, defaultValue ); // doesn't create anything
+		a.set( 25, 100, 7 );          // leaves empty rows in between
+		a.set( 25, 90, 8 );           // and some defaults inside a row
+
+		TS_ASSERT_EQUALS( a.count( defaultValue ), 9 );
+		TS_ASSERT_EQUALS( a.count_not_default(), a.values() - 9 );
+		TS_ASSERT_EQUALS( a.min_value(), 7 );
+		TS_ASSERT_EQUALS( a.max_value(), 1937 );
+
+		int64_t sum = 0;
+		for( size_t row=a.min(); row<=a.max(); ++row )
+			for( int val : a.get_row( row ) )
+				sum += val;
+		TS_ASSERT_EQUALS( a.sum(), sum );
+
+		size_t row = 0, col = 0;
+		TS_ASSERT( a.find_first( 1520, row, col ) );
+		TS_ASSERT_EQUALS( row, 15 );
+		TS_ASSERT_EQUALS( col, 20 );
+		TS_ASSERT( a.find_first( 7, row, col ) );
+		TS_ASSERT_EQUALS( row, 25 );
+		TS_ASSERT_EQUALS( col, 100 );
+		TS_ASSERT( !a.find_first( 3, row, col ) );
+
+		OffsetMatrix<int, OffsetSparseVector<int> > b( defaultValue );
+		b.set( 3, 10, 1 );
+		b.set( 3, 100000, 2 );
+		TS_ASSERT_EQUALS( b.count_not_default(), 2 );
+		TS_ASSERT_EQUALS( b.sum(), 3 );
+		TS_ASSERT_EQUALS( b.max_value(), 2 );
+		TS_ASSERT( b.find_first( 2, row, col ) );
+		TS_ASSERT_EQUALS( col, 100000 );
+	}
+
+	void test_move()
+	{
+		OffsetMatrix<std::string> store( "" );
+		std::string value( 100, 'x' );
+
+		store.set( 10, 5, std::move( value ) );
+		store.emplace( 12, 7, 3, 'y' );
+		TS_ASSERT_EQUALS( store.get( 10, 5 ), std::string( 100, 'x' ) );
+		TS_ASSERT_EQUALS( store.get( 12, 7 ), "yyy" );
+
+		TS_ASSERT_EQUALS( store.find( 9, 5 ), nullptr );
+		TS_ASSERT_EQUALS( store.find( 11, 5 ), nullptr );
+		TS_ASSERT_EQUALS( *store.find( 12, 7 ), "yyy" );
+		TS_ASSERT_EQUALS( &store.get_ref( 20, 20 ), &store.defaultValue );
+
+		OffsetMatrix<std::string> moved( std::move( store ) );
+		TS_ASSERT_EQUALS( moved.min(), 10 );
+		TS_ASSERT_EQUALS( moved.get_ref( 10, 5 ), std::string( 100, 'x' ) );
+		TS_ASSERT( store.empty() );
+
+		store = std::move( moved );
+		TS_ASSERT_EQUALS( store.get( 12, 7 ), "yyy" );
+
+		// sparse rows find through their runs
+		OffsetMatrix<int, OffsetSparseVector<int, 4> > sparse( -1 );
+		sparse.set( 1, 10, 1 );
+		sparse.set( 1, 1000, 2 );
+		TS_ASSERT_EQUALS( *sparse.find( 1, 1000 ), 2 );
+		TS_ASSERT_EQUALS( sparse.find( 1, 500 ), nullptr );
+		TS_ASSERT_EQUALS( sparse.get_ref( 1, 500 ), -1 );
+	}
+
+	void test_columns()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		size_t colMin = 0, colMax = 0;
+		TS_ASSERT( !store.column_extent( colMin, colMax ) );
+
+		test::fill( store );
+		store.get_row( 22 ); // empty row at the end
+		TS_ASSERT( store.column_extent( colMin, colMax ) );
+		TS_ASSERT_EQUALS( colMin, 10 );
+		TS_ASSERT_EQUALS( colMax, 37 );
+
+		std::vector<int> column( store.size() );
+		store.get_column( 15, column.data() );
+		for( size_t row=store.min(); row<=store.max(); ++row )
+			TS_ASSERT_EQUALS( column[row - store.min()], store.get( row, 15 ) );
+		TS_ASSERT_EQUALS( column[15 - 10], 1515 );
+		TS_ASSERT_EQUALS( column[16 - 10], defaultValue );
+
+		// a range past both ends of the matrix
+		column.assign( 40, 0 );
+		store.get_column( 20, 0, 39, column.data() );
+		for( size_t row=0; row<40; ++row )
+			TS_ASSERT_EQUALS( column[row], store.get( row, 20 ) );
+	}
+
+	void test_transpose()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+		store.set( 5, 200, 1 ); // wider than one block
+		store.set( 25, 3, 2 );
+
+		TS_ASSERT( OffsetMatrix<int>( defaultValue ).transpose().empty() );
+
+		for( size_t threads=1; threads<=3; ++threads )
+		{
+			OffsetMatrix<int> t = store.transpose( threads );
+			TS_ASSERT_EQUALS( t.min(), 3 );
+			TS_ASSERT_EQUALS( t.max(), 200 );
+			TS_ASSERT_EQUALS( t.get_row( 15 ).min(), 10 );
+			TS_ASSERT_EQUALS( t.get_row( 15 ).max(), 15 );
+
+			for( size_t row=0; row<30; ++row )
+				for( size_t col=0; col<210; ++col )
+					TS_ASSERT_EQUALS( t.get( col, row ), store.get( row, col ) );
+
+			// and back again
+			OffsetMatrix<int> back = t.transpose( threads );
+			for( size_t row=0; row<30; ++row )
+				for( size_t col=0; col<210; ++col )
+					TS_ASSERT_EQUALS( back.get( row, col ), store.get( row, col ) );
+		}
+	}
+
+	void test_compact()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		// first and last rows back to the default, the rest lose their first column
+		for( size_t row=10; row<20; ++row )
+			for( size_t col=row; col<row*2; ++col )
+				if( row == 10 || row == 19 || col == row )
+					store.set( row, col, defaultValue );
+
+		const size_t values = store.values();
+		TS_ASSERT_EQUALS( store.compact(), 0 );
+
+		TS_ASSERT_EQUALS( store.min(), 11 );
+		TS_ASSERT_EQUALS( store.max(), 18 );
+		TS_ASSERT_EQUALS( store.front_capacity(), 0 );
+		TS_ASSERT_EQUALS( store.back_capacity(), 0 );
+		TS_ASSERT_EQUALS( store.values(), values - 10 - 19 - 8 );
+		TS_ASSERT_EQUALS( store.get_row( 15 ).min(), 16 );
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 1520 );
+		TS_ASSERT_EQUALS( store.get( 10, 10 ), defaultValue );
+
+		// a tiny budget does one row per call
+		store.set( 11, 11, defaultValue );
+		for( size_t row=11; row<=18; ++row )
+			store.set( row, row +1, defaultValue );
+
+		size_t calls = 1;
+		for( size_t left = store.compact( std::chrono::nanoseconds( 1 ) ); left > 0; ++calls )
+		{
+			const size_t next = store.compact( std::chrono::nanoseconds( 1 ) );
+			TS_ASSERT_LESS_THAN( next, left );
+			left = next;
+		}
+		TS_ASSERT( calls > 1 );
+		TS_ASSERT_EQUALS( store.get_row( 15 ).min(), 17 );
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 1520 );
+
+		// everything back to the default
+		for( size_t row=11; row<=18; ++row )
+			for( size_t col=row; col<row*2; ++col )
+				store.set( row, col, defaultValue );
+		store.compact();
+		TS_ASSERT( store.empty() );
+
+		OffsetMatrix<int, OffsetSparseVector<int, 4> > sparse( defaultValue );
+		sparse.set( 1, 10, 1 );
+		sparse.set( 1, 1000, 2 );
+		sparse.set( 2, 5, 3 );
+		sparse.set( 1, 10, defaultValue );
+		sparse.set( 2, 5, defaultValue );
+		sparse.compact();
+		TS_ASSERT_EQUALS( sparse.min(), 1 );
+		TS_ASSERT_EQUALS( sparse.max(), 1 );
+		TS_ASSERT_EQUALS( sparse.get_row( 1 ).runs().size(), 1 );
+	}
+
+	void test_delta()
+	{
+		const std::string first = filename + ".1", second = filename + ".2";
+		remove( format::manifest( filename ).c_str() );
+
+		OffsetMatrix<int> store( defaultValue ), expected( defaultValue );
+		test::fill( store );
+		test::fill( expected );
+		TS_ASSERT( !store.save( filename ) );
+
+		// nothing to save without tracking
+		TS_ASSERT( store.save_delta( filename, first ) );
+
+		store.track_changes();
+		store.set( 12, 15, 1 );
+		store.set( 15, 20, defaultValue );
+		store.set( 25, 30, 2 );
+		store.set( 25, 31, 3 );
+		TS_ASSERT_EQUALS( store.changed_rows(), 3 );
+		TS_ASSERT( !store.save_delta( filename, first ) );
+		TS_ASSERT_EQUALS( store.changed_rows(), 0 );
+
+		// a row grown at the front and the rows past 19 dropped again
+		store.set( 5, 6, 4 );
+		store.set( 25, 30, defaultValue );
+		store.set( 25, 31, defaultValue );
+		store.compact();
+		TS_ASSERT_EQUALS( store.max(), 19 );
+		TS_ASSERT( !store.save_delta( filename, second ) );
+
+		expected.set( 12, 15, 1 );
+		expected.set( 15, 20, defaultValue );
+		expected.set( 5, 6, 4 );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		compare( loaded, store );
+		compare( loaded, expected );
+		TS_ASSERT_EQUALS( loaded.changed_rows(), 0 );
+
+		// the base on its own is still the matrix it was saved as
+		OffsetMatrix<int> base( defaultValue );
+		TS_ASSERT( !base.load( filename ) );
+		TS_ASSERT_EQUALS( base.get( 12, 15 ), 1215 );
+		TS_ASSERT_EQUALS( base.min(), 10 );
+
+		OffsetMatrix<int> folded( defaultValue );
+		TS_ASSERT( !folded.compact_chain( filename ) );
+		compare( folded, expected );
+		TS_ASSERT( !std::ifstream( format::manifest( filename ) ).good() );
+		TS_ASSERT( !std::ifstream( first ).good() );
+		TS_ASSERT( !std::ifstream( second ).good() );
+
+		TS_ASSERT( !base.load_chain( filename ) );
+		compare( base, expected );
+
+		remove( first.c_str() );
+		remove( second.c_str() );
+		remove( format::manifest( filename ).c_str() );
+	}
+
+	void test_delta_resave()
+	{
+		const std::string first = filename + ".1", second = filename + ".2";
+
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+		TS_ASSERT( !store.save( filename ) );
+
+		store.track_changes();
+		store.set( 12, 15, 20 );
+		TS_ASSERT( !store.save_delta( filename, first ) );
+
+		// a full save starts the chain again, the old delta is not replayed
+		store.set( 12, 15, 30 );
+		TS_ASSERT( !store.save( filename ) );
+		TS_ASSERT( !std::ifstream( format::manifest( filename ) ).good() );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		TS_ASSERT_EQUALS( loaded.get( 12, 15 ), 30 );
+		compare( loaded, store );
+
+		// and deltas after it apply to the new base
+		store.clear_changes();
+		store.set( 13, 15, 40 );
+		TS_ASSERT( !store.save_delta( filename, second ) );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		TS_ASSERT_EQUALS( loaded.get( 12, 15 ), 30 );
+		TS_ASSERT_EQUALS( loaded.get( 13, 15 ), 40 );
+
+		// as does save_v1()
+		TS_ASSERT( !store.save_v1( filename ) );
+		TS_ASSERT( !std::ifstream( format::manifest( filename ) ).good() );
+
+		remove( first.c_str() );
+		remove( second.c_str() );
+	}
+
+	void test_delta_moved()
+	{
+		const std::string first = filename + ".1", second = filename + ".2";
+		remove( format::manifest( filename ).c_str() );
+
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+		TS_ASSERT( !store.save( filename ) );
+
+		// the changes go with the matrix, the source stops tracking
+		store.track_changes();
+		store.set( 12, 15, 1 );
+		OffsetMatrix<int> moved( std::move( store ) );
+		TS_ASSERT( moved.tracking_changes() );
+		TS_ASSERT_EQUALS( moved.changed_rows(), 1 );
+		TS_ASSERT( !store.tracking_changes() );
+		TS_ASSERT_EQUALS( store.changed_rows(), 0 );
+		TS_ASSERT( store.save_delta( filename, first ) );
+		TS_ASSERT( !moved.save_delta( filename, first ) );
+
+		moved.set( 13, 15, 2 );
+		store = std::move( moved );
+		TS_ASSERT( store.tracking_changes() );
+		TS_ASSERT_EQUALS( store.changed_rows(), 1 );
+		TS_ASSERT( !moved.tracking_changes() );
+		TS_ASSERT( !store.save_delta( filename, second ) );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		TS_ASSERT_EQUALS( loaded.get( 12, 15 ), 1 );
+		TS_ASSERT_EQUALS( loaded.get( 13, 15 ), 2 );
+		compare( loaded, store );
+
+		remove( first.c_str() );
+		remove( second.c_str() );
+		remove( format::manifest( filename ).c_str() );
+	}
+
+	void test_delta_far_rows()
+	{
+		const std::string first = filename + ".1", second = filename + ".2";
+		remove( format::manifest( filename ).c_str() );
+
+		OffsetMatrix<int> store( defaultValue );
+		for( size_t row=0; row<5; ++row )
+			store.set( row, 0, 1 );
+		TS_ASSERT( !store.save( filename ) );
+
+		// the removed rows are in the delta, and one row far past them
+		store.track_changes();
+		store.clear();
+		store.set( 20000000, 3, 2 );
+		TS_ASSERT( !store.save_delta( filename, first ) );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		TS_ASSERT_EQUALS( loaded.min(), 20000000 );
+		TS_ASSERT_EQUALS( loaded.size(), 1 );
+		TS_ASSERT_EQUALS( loaded.get( 20000000, 3 ), 2 );
+		TS_ASSERT_EQUALS( loaded.get( 0, 0 ), defaultValue );
+		TS_ASSERT_LESS_THAN( loaded.memory().bytesAllocated, 1000 );
+
+		// and a delta with no changes at all
+		TS_ASSERT( !store.save_delta( filename, second ) );
+		TS_ASSERT( !loaded.load_chain( filename ) );
+		TS_ASSERT_EQUALS( loaded.get( 20000000, 3 ), 2 );
+
+		remove( first.c_str() );
+		remove( second.c_str() );
+		remove( format::manifest( filename ).c_str() );
+	}
+
+	void test_save_async()
+	{
+		OffsetMatrix<int> store( defaultValue ), expected( defaultValue );
+		test::fill( store );
+		test::fill( expected );
+
+		// changes after the call don't reach the file
+		std::future<bool> saved = store.save_async( filename );
+		store.set( 12, 15, 1 );
+		store.set( 40, 40, 2 );
+		store.clear();
+		TS_ASSERT( !saved.get() );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load( filename ) );
+		compare( loaded, expected );
+
+		TS_ASSERT( !store.save_async( filename ).get() );
+		TS_ASSERT( !loaded.load( filename ) );
+		TS_ASSERT( loaded.empty() );
+
+		TS_ASSERT( store.save_async( "no/such/dir/offsetmatrix_test.bin" ).get() );
+	}
+
+	void test_save_async_dropped()
+	{
+		// opening a fifo to write waits for a reader, so the save can't finish yet
+		const std::string fifo = filename + ".fifo";
+		remove( fifo.c_str() );
+		TS_ASSERT_EQUALS( mkfifo( fifo.c_str(), 0644 ), 0 );
+
+		{
+			OffsetMatrix<int> store( defaultValue );
+			test::fill( store );
+			store.save_async( fifo );
+		}
+
+		// got here with the save still waiting, now let it run to the end
+		const int fd = open( fifo.c_str(), O_RDONLY );
+		TS_ASSERT( fd >= 0 );
+		char buffer[256];
+		while( read( fd, buffer, sizeof(buffer) ) > 0 ) {}
+		close( fd );
+
+		remove( fifo.c_str() );
+	}
+
 	/*void ttest_size()
 	{
 		auto values = {1,2,3,4,5,10};
@@ -0,0 +1,230 @@
+#ifndef OFFSETMATRIXBUILDER_H
+#define OFFSETMATRIXBUILDER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "offsetarena.h"
+#include "offsetmatrix.h"
+#include "offsetparallel.h"
+
+namespace offset
+{
+
+/* builds an OffsetMatrix from (row, col, value) triples added in any order.
+	calling set() for each value grows a row whenever a value lands
+	outside it, the builder instead sorts the triples by row then column,
+	sizes every row from its first and last column, allocates it once and
+	then fills it in, so a build is a sort and two linear passes.
+
+	if the same row, col is added more than once the value added last is
+	kept. values equal to defaultValue are not stored, as with set().
+	the matrix built can have any row type with dense rows */
+template <typename T>
+class OffsetMatrixBuilder
+{
+public:
+	struct Triple
+	{
+		size_t row;
+		size_t col;
+		T value;
+	};
+
+private:
+	std::vector<Triple> triples;
+	bool sorted = true;
+
+	static bool before( const Triple& a, const Triple& b )
+	{
+		return a.row < b.row || (a.row == b.row && a.col < b.col);
+	}
+
+	/* note if row, col comes before the last triple added */
+	void check_order( size_t row, size_t col )
+	{
+		if( sorted && !triples.empty() && 
+			(row < triples.back().row || (row == triples.back().row && col < triples.back().col)) )
+			sorted = false;
+	}
+
+	/* keep the last of every run of triples with the same row, col,
+		then drop the ones that are defaultValue */
+	void unique( const T& defaultValue );
+
+public:
+	T defaultValue;
+
+	OffsetMatrixBuilder( const T& defaultValue ) : defaultValue(defaultValue) {}
+
+	/* make room for n triples */
+	void reserve( const size_t n ) { triples.reserve( n ); }
+
+	/* number of triples added since the last build() */
+	size_t size() const { return triples.size(); }
+	bool empty() const { return triples.empty(); }
+
+	void clear()
+	{
+		triples.clear();
+		sorted = true;
+	}
+
+	/* add the value at row, col */
+	void add( size_t row, size_t col, const T& val );
+	void add( size_t row, size_t col, T&& val );
+
+	/* sort the triples by row then column, keeping the order they were
+		added in for the same row, col. split between threads threads,
+		0 for parallel::default_threads(), that each sort a part before
+		the parts are merged. build() sorts anyway if it has to */
+	void sort( size_t threads=1 );
+
+	/* replace the contents of matrix with the triples, rows are created
+		with the matrix's allocator and defaultValue. the sort and filling
+		the rows are split between threads threads. the builder is
+		empty afterwards */
+	template <typename RowType>
+	void build( OffsetMatrix<T, RowType>& matrix, size_t threads=1 );
+
+	/* as above, into a new matrix with defaultValue */
+	OffsetMatrix<T> build( size_t threads=1 )
+	{
+		OffsetMatrix<T> matrix( defaultValue );
+		build( matrix, threads );
+
+		return matrix;
+	}
+};
+
+template <typename T>
+void OffsetMatrixBuilder<T>::add( size_t row, size_t col, const T& val )
+{
+	check_order( row, col );
+	triples.push_back( Triple{ row, col, val } );
+}
+
+template <typename T>
+void OffsetMatrixBuilder<T>::add( size_t row, size_t col, T&& val )
+{
+	check_order( row, col );
+	triples.push_back( Triple{ row, col, std::move( val ) } );
+}
+
+template <typename T>
+void OffsetMatrixBuilder<T>::sort( size_t threads )
+{
+	if( sorted ) return;
+	if( threads == 0 ) threads = parallel::default_threads();
+
+	/* each thread sorts one part, then neighbouring parts are merged
+		in pairs until there is only one. both steps are stable */
+	const std::vector<size_t> bounds = parallel::split( triples.size(), threads, []( size_t ) { return 1; } );
+	const size_t parts = bounds.size() -1;
+	auto first = triples.begin();
+
+	parallel::for_each_index( parts, threads, [&]( size_t k )
+	{
+		std::stable_sort( first + bounds[k], first + bounds[k+1], before );
+	} );
+
+	for( size_t width=1; width<parts; width*=2 )
+	{
+		parallel::for_each_index( (parts + 2*width -1) / (2*width), threads, [&]( size_t k )
+		{
+			const size_t lo = 2*width*k;
+			const size_t mid = std::min( lo + width, parts );
+			const size_t hi = std::min( lo + 2*width, parts );
+
+			std::inplace_merge( first + bounds[lo], first + bounds[mid], first + bounds[hi], before );
+		} );
+	}
+
+	sorted = true;
+}
+
+template <typename T>
+void OffsetMatrixBuilder<T>::unique( const T& defaultValue )
+{
+	size_t out = 0;
+	for( size_t i=0; i<triples.size(); ++i )
+	{
+		if( out > 0 && triples[out-1].row == triples[i].row && triples[out-1].col == triples[i].col )
+			triples[out-1] = std::move( triples[i] );
+		else if( out != i )
+			triples[out++] = std::move( triples[i] );
+		else
+			++out;
+	}
+	triples.erase( triples.begin() + out, triples.end() );
+
+	triples.erase( std::remove_if( triples.begin(), triples.end(),
+		[&defaultValue]( const Triple& t ) { return t.value == defaultValue; } ), triples.end() );
+}
+
+template <typename T>
+template <typename RowType>
+void OffsetMatrixBuilder<T>::build( OffsetMatrix<T, RowType>& matrix, size_t threads )
+{
+	typedef typename OffsetMatrix<T, RowType>::Row Row;
+
+	if( threads == 0 ) threads = parallel::default_threads();
+
+	matrix.clear();
+
+	sort( threads );
+	unique( matrix.defaultValue );
+
+	if( triples.empty() ) return;
+
+	/* first pass, where each row starts in triples and how many values it needs */
+	std::vector<size_t> starts;
+	size_t total = 0;
+	for( size_t i=0; i<triples.size(); ++i )
+	{
+		if( i > 0 && triples[i].row == triples[i-1].row ) continue;
+
+		if( i > 0 ) total += triples[i-1].col - triples[starts.back()].col +1;
+		starts.push_back( i );
+	}
+	total += triples.back().col - triples[starts.back()].col +1;
+	starts.push_back( triples.size() );
+
+	const size_t rowsMin = triples.front().row;
+	const size_t rowsMax = triples.back().row;
+	typename OffsetMatrix<T, RowType>::allocator_type alloc = matrix.get_allocator();
+
+	/* every row and value in one go, as OffsetMatrix::load() */
+	reserve_allocator( alloc, sizeof(Row) * (rowsMax - rowsMin +1) + sizeof(T) * total +
+							  alignof(Row) + alignof(T) * (starts.size() -1) );
+	matrix.reserve_rows( rowsMin, rowsMax );
+	matrix.get_row( rowsMin );
+	matrix.get_row( rowsMax );
+
+	/* second pass, allocate each row once and fill it */
+	const std::vector<size_t> chunks = parallel::split( starts.size() -1, threads*4,
+		[&starts]( size_t g ) { return starts[g+1] - starts[g] +1; } );
+	auto rows = matrix.begin();
+
+	parallel::for_each_index( chunks.size() -1, threads, [&]( size_t chunk )
+	{
+		for( size_t g=chunks[chunk]; g<chunks[chunk+1]; ++g )
+		{
+			const Triple &first = triples[ starts[g] ];
+			const Triple &last = triples[ starts[g+1] -1 ];
+
+			Row &r = rows[ first.row - rowsMin ];
+			r = Row( first.col, last.col - first.col +1, matrix.defaultValue, alloc );
+
+			for( size_t i=starts[g]; i<starts[g+1]; ++i )
+				r[ triples[i].col ] = std::move( triples[i].value );
+		}
+	} );
+
+	clear();
+	triples.shrink_to_fit();
+}
+
+}
+
+#endif
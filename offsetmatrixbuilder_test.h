@@ -0,0 +1,130 @@
+#include <cxxtest/TestSuite.h>
+#include <random>
+#include "offsetarena.h"
+#include "offsetmatrix.h"
+#include "offsetmatrixbuilder.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class OffsetMatrixBuilderTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+	struct Value
+	{
+		size_t row, col;
+		int value;
+	};
+
+	/* values at random coordinates, some of them repeated */
+	std::vector<Value> random_values( const size_t n )
+	{
+		std::mt19937 rng( 42 );
+		std::vector<Value> values;
+		for( size_t i=0; i<n; ++i )
+			values.push_back( Value{ 100 + rng() % 50, 1000 + rng() % 200, (int)(rng() % 10) } );
+
+		return values;
+	}
+
+	template <typename Matrix>
+	void check( const Matrix &store, const OffsetMatrix<int> &expected )
+	{
+		TS_ASSERT_EQUALS( store.min(), expected.min() );
+		TS_ASSERT_EQUALS( store.max(), expected.max() );
+		for( size_t row=expected.min(); row<=expected.max(); ++row )
+		{
+			TS_ASSERT_EQUALS( store.get_row( row ).min(), expected.get_row( row ).min() );
+			TS_ASSERT_EQUALS( store.get_row( row ).size(), expected.get_row( row ).size() );
+
+			for( size_t col=1000; col<1200; ++col )
+				TS_ASSERT_EQUALS( store.get( row, col ), expected.get( row, col ) );
+		}
+	}
+
+public:
+	void setUp()
+	{
+		defaultValue = 0;
+	}
+
+	void test_empty()
+	{
+		OffsetMatrixBuilder<int> builder( defaultValue );
+		TS_ASSERT( builder.build().empty() );
+
+		// nothing but default values
+		builder.add( 5, 5, defaultValue );
+		TS_ASSERT( builder.build().empty() );
+		TS_ASSERT( builder.empty() );
+	}
+
+	void test_sorted()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		OffsetMatrixBuilder<int> builder( defaultValue );
+		test::fill( expected );
+		test::for_each_cell( [&builder]( size_t row, size_t col, int val ) { builder.add( row, col, val ); } );
+
+		OffsetMatrix<int> store = builder.build();
+		TS_ASSERT_EQUALS( store.values(), expected.values() );
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 1520 );
+		TS_ASSERT_EQUALS( store.get( 15, 30 ), defaultValue );
+
+		// rows are allocated exactly, nothing spare
+		for( size_t row=10; row<20; ++row )
+			TS_ASSERT_EQUALS( store.get_row( row ).back_capacity(), 0 );
+	}
+
+	void test_unsorted()
+	{
+		const std::vector<Value> values = random_values( 5000 );
+
+		OffsetMatrix<int> expected( defaultValue );
+		OffsetMatrixBuilder<int> builder( defaultValue );
+		for( const Value &v : values )
+		{
+			expected.set( v.row, v.col, v.value );
+			builder.add( v.row, v.col, v.value );
+		}
+		expected.compact();
+
+		// the last value added for a repeated row, col wins, even the default
+		builder.add( 120, 1100, 7 );
+		builder.add( 120, 1100, defaultValue );
+		expected.set( 120, 1100, defaultValue );
+
+		OffsetMatrix<int> store = builder.build();
+		check( store, expected );
+		TS_ASSERT_EQUALS( store.get( 120, 1100 ), defaultValue );
+	}
+
+	void test_parallel()
+	{
+		const std::vector<Value> values = random_values( 20000 );
+
+		OffsetMatrix<int> expected( defaultValue );
+		OffsetMatrixBuilder<int> builder( defaultValue );
+		for( const Value &v : values )
+		{
+			expected.set( v.row, v.col, v.value );
+			builder.add( v.row, v.col, v.value );
+		}
+		expected.compact();
+
+		OffsetMatrix<int> store = builder.build( 4 );
+		check( store, expected );
+
+		// into a matrix with its values in one arena block
+		for( const Value &v : values )
+			builder.add( v.row, v.col, v.value );
+
+		Arena arena( 64 );
+		OffsetMatrix<int, OffsetVector<int, ArenaAllocator<int> > > arenaStore( defaultValue, arena );
+		builder.build( arenaStore, 3 );
+		check( arenaStore, expected );
+		TS_ASSERT_EQUALS( arena.size(), 1 );
+	}
+};
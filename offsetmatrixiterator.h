@@ -0,0 +1,140 @@
+#ifndef OFFSETMATRIXITERATOR_H
+#define OFFSETMATRIXITERATOR_H
+
+#include <cstddef>
+#include <iterator>
+
+namespace offset
+{
+
+/* one stored value of a matrix and where it is */
+template <typename T>
+struct OffsetMatrixEntry
+{
+	size_t row;
+	size_t col;
+	T& value;
+};
+
+/* iterates over every stored value of a matrix with dense rows, rows in
+	order then columns, yielding OffsetMatrixEntry<T>. values are walked
+	through each row's data() pointer so the only per value work is the
+	end of row check. if skip is set then values equal to *skip are
+	stepped over, see OffsetMatrix::nonDefault() */
+template <typename RowIterator, typename T>
+class OffsetMatrixIterator
+{
+private:
+	RowIterator r, rEnd;
+	size_t row = 0;
+	size_t colsMin = 0;
+
+	T* first = nullptr;
+	T* p = nullptr;      // nullptr at the end
+	T* pEnd = nullptr;
+
+	const T* skip = nullptr;
+
+	/* point at the first value of r, or the first row after it with values */
+	void load();
+
+	/* step over values equal to *skip */
+	void skip_defaults();
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef OffsetMatrixEntry<T> value_type;
+	typedef OffsetMatrixEntry<T> reference;
+	typedef void pointer;
+	typedef std::ptrdiff_t difference_type;
+
+	// end iterator
+	OffsetMatrixIterator() {}
+
+	/* iterate over the rows begin to end, the first of which is row number row */
+	OffsetMatrixIterator( RowIterator begin, RowIterator end, size_t row, const T* skip=nullptr );
+
+	OffsetMatrixEntry<T> operator*() const { return OffsetMatrixEntry<T>{ row, colsMin + size_t( p - first ), *p }; }
+
+	OffsetMatrixIterator& operator++();
+	OffsetMatrixIterator operator++( int ) { OffsetMatrixIterator i( *this ); ++*this; return i; }
+
+	bool operator==( const OffsetMatrixIterator& other ) const { return p == other.p; }
+	bool operator!=( const OffsetMatrixIterator& other ) const { return p != other.p; }
+};
+
+/* begin/end pair for range based for loops */
+template <typename Iterator>
+class OffsetMatrixRange
+{
+private:
+	Iterator b, e;
+
+public:
+	OffsetMatrixRange( Iterator begin, Iterator end ) : b(begin), e(end) {}
+
+	Iterator begin() const { return b; }
+	Iterator end() const { return e; }
+};
+
+template <typename RowIterator, typename T>
+OffsetMatrixIterator<RowIterator, T>::OffsetMatrixIterator( RowIterator begin, RowIterator end, size_t row, const T* skip ) :
+	r(begin), rEnd(end), row(row), skip(skip)
+{
+	load();
+	skip_defaults();
+}
+
+template <typename RowIterator, typename T>
+void OffsetMatrixIterator<RowIterator, T>::load()
+{
+	while( r != rEnd && r->empty() )
+	{
+		++r;
+		++row;
+	}
+
+	if( r == rEnd )
+	{
+		p = nullptr;
+		return;
+	}
+
+	colsMin = r->min();
+	first = p = r->data();
+	pEnd = p + r->size();
+}
+
+template <typename RowIterator, typename T>
+void OffsetMatrixIterator<RowIterator, T>::skip_defaults()
+{
+	if( !skip ) return;
+
+	while( p && *p == *skip )
+	{
+		if( ++p != pEnd ) continue;
+
+		++r;
+		++row;
+		load();
+	}
+}
+
+template <typename RowIterator, typename T>
+OffsetMatrixIterator<RowIterator, T>& OffsetMatrixIterator<RowIterator, T>::operator++()
+{
+	if( ++p == pEnd )
+	{
+		++r;
+		++row;
+		load();
+	}
+
+	skip_defaults();
+
+	return *this;
+}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include "offsetmatrix.h"
+#include "offsetmatrixiterator.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class OffsetMatrixIteratorTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_empty()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		TS_ASSERT( store.elements().begin() == store.elements().end() );
+		TS_ASSERT( store.nonDefault().begin() == store.nonDefault().end() );
+
+		// rows with nothing in them are skipped
+		store.get_row( 5 );
+		store.get_row( 8 );
+		TS_ASSERT( store.elements().begin() == store.elements().end() );
+	}
+
+	void test_elements()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+		store.get_row( 25 );  // empty row at the end
+
+		size_t count = 0;
+		size_t lastRow = 0, lastCol = 0;
+		for( OffsetMatrixEntry<int> e : store.elements() )
+		{
+			TS_ASSERT_EQUALS( e.value, store.get( e.row, e.col ) );
+			TS_ASSERT_EQUALS( &e.value, &store.at_unchecked( e.row, e.col ) );
+			TS_ASSERT( e.row > lastRow || (e.row == lastRow && e.col > lastCol) );
+
+			lastRow = e.row;
+			lastCol = e.col;
+			++count;
+		}
+		TS_ASSERT_EQUALS( count, store.values() );
+
+		// values can be changed through the entries
+		for( OffsetMatrixEntry<int> e : store.elements() )
+			e.value = (int)e.col;
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 20 );
+
+		const OffsetMatrix<int> &constStore = store;
+		count = 0;
+		for( OffsetMatrixEntry<const int> e : constStore.elements() )
+			count += e.value == (int)e.col;
+		TS_ASSERT_EQUALS( count, store.values() );
+	}
+
+	void test_non_default()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		store.set( 3, 10, 1 );
+		store.set( 3, 14, 2 );
+		store.set( 7, 2, defaultValue );  // not stored at all
+		store.set( 9, 5, 3 );
+		store.set( 9, 5, defaultValue );  // stored as the default
+		store.set( 9, 6, 4 );
+
+		std::vector<size_t> cols;
+		for( OffsetMatrixEntry<int> e : store.nonDefault() )
+		{
+			TS_ASSERT_DIFFERS( e.value, defaultValue );
+			cols.push_back( e.col );
+		}
+
+		TS_ASSERT_EQUALS( cols.size(), 3 );
+		TS_ASSERT_EQUALS( cols[0], 10 );
+		TS_ASSERT_EQUALS( cols[1], 14 );
+		TS_ASSERT_EQUALS( cols[2], 6 );
+		TS_ASSERT_EQUALS( store.count_not_default(), cols.size() );
+	}
+
+	void test_row_index()
+	{
+		OffsetVector<int> row( defaultValue );
+		row.set( 100, 1 );
+		row.set( 103, 4 );
+
+		TS_ASSERT_EQUALS( row[100], 1 );
+		TS_ASSERT_EQUALS( row[101], defaultValue );
+		TS_ASSERT_EQUALS( row[103], 4 );
+
+		row[101] = 2;
+		TS_ASSERT_EQUALS( row.get( 101 ), 2 );
+	}
+};
@@ -0,0 +1,286 @@
+#ifndef OFFSETMATRIXREADER_H
+#define OFFSETMATRIXREADER_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "offsetformat.h"
+
+namespace offset
+{
+
+/* streaming reader for a file written by OffsetMatrix::save() or save_v1().
+	rows are handed out one at a time from a fixed size buffer, nothing is
+	allocated per row, so files far larger than memory can be scanned once
+	at disk speed without building an OffsetMatrix.
+
+	rows longer than the buffer are handed out as several consecutive
+	pieces of the same row, each with its own first column. empty rows are
+	skipped. encoded rows (see SaveOptions::codec) are decoded whole into a
+	separate buffer that grows to fit the longest encoded row. */
+template <typename T>
+class OffsetMatrixReader
+{
+	static_assert( alignof(T) <= alignof(uint64_t), "buffer is only uint64_t aligned" );
+	static_assert( std::is_trivially_copyable<T>::value, "values are read back as raw bytes" );
+
+public:
+	/* a row, or a piece of one, straight out of the read buffer.
+		only valid until the next call to next() */
+	struct Row
+	{
+		size_t row;
+		size_t colsMin;
+		size_t colsNum;
+		const T* data;
+
+		const T* begin() const { return data; }
+		const T* end() const { return data + colsNum; }
+	};
+
+private:
+	static const size_t tableEntries = 4096; // row table entries read at a time
+
+	int fd = -1;
+	bool v2 = false;
+	bool failed = false;
+
+	uint64_t total = 0, rowsMin = 0, rowsNum = 0;
+	uint64_t tableOffset = 0;
+
+	// window of the file currently held in buffer, kept uint64_t aligned for T
+	std::vector<uint64_t> buffer;
+	uint64_t windowStart = 0, windowSize = 0;
+
+	// window of the row table (version 2 only)
+	std::vector<format::RowEntry> entries;
+	size_t entriesStart = 0;
+
+	size_t row = 0;         // number of rows started so far
+	uint64_t pos = 0;       // file position of the next row header (version 1 only)
+
+	// row currently being handed out
+	size_t colsMin = 0, colsNum = 0, done = 0;
+	uint64_t payload = 0;   // file position of the row values
+
+	// decoded values of the current row, if it was encoded
+	bool encoded = false;
+	std::vector<T> decoded;
+	std::vector<char> scratch;
+
+	size_t capacity() const { return buffer.size() * sizeof(uint64_t); }
+
+	/* make sure the file range [offset, offset+bytes) is in the buffer,
+		returns a pointer to it or nullptr if error */
+	const char* fetch( const uint64_t offset, const size_t bytes );
+
+	/* move on to the next row, returns false at the end of the file */
+	bool next_row();
+
+public:
+	OffsetMatrixReader( const size_t bufferSize = 4 << 20 ) :
+		buffer( (std::max( bufferSize, std::max( sizeof(T), (size_t)format::alignment ) )
+				+ sizeof(uint64_t) -1) / sizeof(uint64_t) ) {}
+
+	~OffsetMatrixReader() { close(); }
+
+	OffsetMatrixReader( const OffsetMatrixReader<T>& other ) = delete;
+	OffsetMatrixReader<T>& operator=( const OffsetMatrixReader<T>& other ) = delete;
+
+	/* open filename and read its header.
+		returns true if error, false if success */
+	bool open( std::string filename );
+	void close();
+
+	/* the number of values, rows and the min row number in the file */
+	size_t values() const { return total; }
+	size_t size() const { return rowsNum; }
+	size_t min() const { return rowsMin; }
+
+	/* true if something went wrong reading the file */
+	bool fail() const { return failed; }
+
+	/* read the next row (or piece of a row) into r.
+		returns false at the end of the file or on error, see fail() */
+	bool next( Row& r );
+};
+
+template <typename T>
+bool OffsetMatrixReader<T>::open( std::string filename )
+{
+	close();
+
+	fd = ::open( filename.c_str(), O_RDONLY );
+	if( fd < 0 ) return failed = true;
+
+	format::Header header;
+	const char* start = fetch( 0, sizeof(uint64_t) * 3 );
+	if( !start ) return failed = true;
+
+	v2 = format::is_v2( start, windowSize );
+	if( v2 )
+	{
+		if( windowSize < sizeof(header) ) return failed = true;
+		memcpy( &header, start, sizeof(header) );
+		if( format::check_header<T>( header ) ) return failed = true;
+
+		total = header.total;
+		rowsMin = header.rowsMin;
+		rowsNum = header.rowsNum;
+		tableOffset = header.tableOffset;
+	}
+	else
+	{
+		memcpy( &total, start, sizeof(uint64_t) );
+		memcpy( &rowsMin, start + sizeof(uint64_t), sizeof(uint64_t) );
+		memcpy( &rowsNum, start + sizeof(uint64_t)*2, sizeof(uint64_t) );
+		pos = sizeof(uint64_t) * 3;
+	}
+
+	return false;
+}
+
+template <typename T>
+void OffsetMatrixReader<T>::close()
+{
+	if( fd >= 0 ) ::close( fd );
+
+	fd = -1;
+	v2 = failed = false;
+	total = rowsMin = rowsNum = tableOffset = 0;
+	windowStart = windowSize = 0;
+	entries.clear();
+	entriesStart = 0;
+	row = 0;
+	pos = 0;
+	colsMin = colsNum = done = 0;
+	payload = 0;
+	encoded = false;
+}
+
+template <typename T>
+const char* OffsetMatrixReader<T>::fetch( const uint64_t offset, const size_t bytes )
+{
+	char* data = reinterpret_cast<char*>( buffer.data() );
+
+	if( offset >= windowStart && offset + bytes <= windowStart + windowSize )
+		return data + (offset - windowStart);
+
+	if( bytes > capacity() ) return nullptr;
+
+	// refill the whole buffer starting at offset, stopping early at the end of the file
+	windowStart = offset;
+	windowSize = 0;
+	while( windowSize < capacity() )
+	{
+		const ssize_t n = ::pread( fd, data + windowSize, capacity() - windowSize, offset + windowSize );
+		if( n < 0 ) return nullptr;
+		if( n == 0 ) break;
+
+		windowSize += n;
+	}
+
+	return windowSize >= bytes ? data : nullptr;
+}
+
+template <typename T>
+bool OffsetMatrixReader<T>::next_row()
+{
+	if( row == rowsNum ) return false;
+
+	if( v2 )
+	{
+		// read the next block of the row table if needed
+		if( row >= entriesStart + entries.size() )
+		{
+			entriesStart = row;
+			entries.resize( std::min( (uint64_t)tableEntries, rowsNum - row ) );
+			if( format::pread_all( fd, entries.data(), sizeof(format::RowEntry) * entries.size(),
+								   tableOffset + sizeof(format::RowEntry) * row ) )
+			{
+				failed = true;
+				return false;
+			}
+		}
+
+		const format::RowEntry &entry = entries[row - entriesStart];
+
+		colsMin = entry.colsMin;
+		colsNum = entry.colsNum;
+		payload = entry.offset;
+
+		encoded = entry.codec != format::RAW;
+		if( encoded )
+		{
+			decoded.resize( colsNum );
+			if( format::read_row( fd, entry, decoded.data(), scratch ) )
+			{
+				failed = true;
+				return false;
+			}
+		}
+		else if( entry.bytes != sizeof(T) * entry.colsNum )
+		{
+			failed = true;
+			return false;
+		}
+	}
+	else
+	{
+		// read the minimum column number and the number of columns
+		const char* header = fetch( pos, sizeof(uint64_t) * 2 );
+		if( !header )
+		{
+			failed = true;
+			return false;
+		}
+
+		uint64_t cols[2];
+		memcpy( cols, header, sizeof(cols) );
+		colsMin = cols[0];
+		colsNum = cols[1];
+		payload = pos + sizeof(cols);
+		pos = payload + sizeof(T) * colsNum;
+	}
+
+	done = 0;
+	++row;
+	return true;
+}
+
+template <typename T>
+bool OffsetMatrixReader<T>::next( Row& r )
+{
+	if( fd < 0 ) return false;
+
+	// skip over finished and empty rows
+	while( done == colsNum )
+		if( failed || !next_row() ) return false;
+
+	const size_t n = std::min( colsNum - done, capacity() / sizeof(T) );
+	const char* data = encoded ? reinterpret_cast<const char*>( decoded.data() + done ) :
+								 fetch( payload + sizeof(T) * done, sizeof(T) * n );
+	if( !data )
+	{
+		failed = true;
+		return false;
+	}
+
+	r.row = rowsMin + row -1;
+	r.colsMin = colsMin + done;
+	r.colsNum = n;
+	r.data = reinterpret_cast<const T*>( data );
+
+	done += n;
+	return true;
+}
+
+}
+
+#endif
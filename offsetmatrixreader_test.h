@@ -0,0 +1,125 @@
+#include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include "offsetmatrix.h"
+#include "offsetmatrixreader.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class OffsetMatrixReaderTest: public CxxTest::TestSuite
+{
+private:
+	std::string filename;
+	int defaultValue;
+
+	void fill( OffsetMatrix<int> &store )
+	{
+		test::fill( store );
+		store.set( 25, 100, 1 ); // leaves empty rows 20 to 24
+	}
+
+	/* rebuild a matrix from everything the reader hands out */
+	void read( OffsetMatrixReader<int> &reader, OffsetMatrix<int> &store, size_t &pieces )
+	{
+		pieces = 0;
+
+		OffsetMatrixReader<int>::Row r;
+		while( reader.next( r ) )
+		{
+			size_t col = r.colsMin;
+			for( int val : r )
+				store.set( r.row, col++, val );
+
+			++pieces;
+		}
+	}
+
+public:
+	void setUp()
+	{
+		filename = "offsetmatrixreader_test.bin";
+		defaultValue = 999;
+	}
+
+	void tearDown()
+	{
+		remove( filename.c_str() );
+	}
+
+	void test_missing_file()
+	{
+		OffsetMatrixReader<int> reader;
+
+		TS_ASSERT( reader.open( "does_not_exist.bin" ) );
+		TS_ASSERT( reader.fail() );
+	}
+
+	void test_read()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		fill( a );
+		TS_ASSERT( !a.save( filename ) );
+
+		OffsetMatrixReader<int> reader;
+		TS_ASSERT( !reader.open( filename ) );
+		TS_ASSERT_EQUALS( a.min(), reader.min() );
+		TS_ASSERT_EQUALS( a.size(), reader.size() );
+		TS_ASSERT_EQUALS( a.values(), reader.values() );
+
+		size_t pieces;
+		read( reader, b, pieces );
+		TS_ASSERT( !reader.fail() );
+		TS_ASSERT_EQUALS( 11, pieces ); // one per non empty row
+
+		TS_ASSERT_EQUALS( a.values(), b.values() );
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( a.get(row, col), b.get(row, col) );
+	}
+
+	void test_read_pieces()
+	{
+		OffsetMatrix<int> a( defaultValue );
+		fill( a );
+
+		// a buffer smaller than the longest row splits rows into pieces
+		OffsetMatrixReader<int> reader( 64 );
+
+		for( int v1=0; v1<2; ++v1 )
+		{
+			OffsetMatrix<int> b( defaultValue );
+			TS_ASSERT( !(v1 ? a.save_v1( filename ) : a.save( filename )) );
+			TS_ASSERT( !reader.open( filename ) );
+
+			size_t pieces;
+			read( reader, b, pieces );
+			TS_ASSERT( !reader.fail() );
+			TS_ASSERT_LESS_THAN( 11, pieces );
+
+			for( size_t row=0; row<30; ++row )
+				for( size_t col=0; col<50; ++col )
+					TS_ASSERT_EQUALS( a.get(row, col), b.get(row, col) );
+		}
+	}
+
+	void test_read_encoded()
+	{
+		OffsetMatrix<int> a( defaultValue ), b( defaultValue );
+		fill( a );
+
+		SaveOptions options;
+		options.codec = format::RLE;
+		TS_ASSERT( !a.save( filename, options ) );
+
+		OffsetMatrixReader<int> reader( 64 );
+		TS_ASSERT( !reader.open( filename ) );
+
+		size_t pieces;
+		read( reader, b, pieces );
+		TS_ASSERT( !reader.fail() );
+
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<110; ++col )
+				TS_ASSERT_EQUALS( a.get(row, col), b.get(row, col) );
+	}
+};
\ No newline at end of file
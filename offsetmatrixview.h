@@ -0,0 +1,237 @@
+#ifndef OFFSETMATRIXVIEW_H
+#define OFFSETMATRIXVIEW_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "offsetformat.h"
+
+namespace offset
+{
+
+/* read only view of a file written by OffsetMatrix::save() or save_v1().
+	the file is memory mapped and values are served straight from the
+	mapped pages, so opening a view is just a read of the row table (or a 
+	scan of the row headers for version 1 files) and
+	several processes mapping the same file share one copy in the page cache */
+template <typename T>
+class OffsetMatrixView
+{
+	static_assert( alignof(T) <= alignof(size_t), "row payloads are only size_t aligned in the file" );
+	static_assert( std::is_trivially_copyable<T>::value, "values are mapped straight from the file" );
+
+public:
+	/* location of one row inside the mapping */
+	struct RowIndex
+	{
+		size_t colsMin;
+		size_t colsNum;
+		const T* data;
+	};
+
+private:
+	void* mapping = nullptr;
+	size_t length = 0;
+
+	size_t mn = 0;
+	std::vector<RowIndex> rows;
+
+	/* build the row index from the row table of a version 2 file */
+	bool map_v2( const char* buffer );
+
+public:
+	T defaultValue = 0;
+
+	OffsetMatrixView( const T& defaultValue ) : defaultValue(defaultValue) {}
+
+	// destructor
+	~OffsetMatrixView() { unmap(); }
+
+	OffsetMatrixView( const OffsetMatrixView<T>& other ) = delete;
+	OffsetMatrixView<T>& operator=( const OffsetMatrixView<T>& other ) = delete;
+
+	/* map filename, assumes file name is a OffsetMatrix::save() or save_v1() 
+		created file. files with encoded rows (see SaveOptions::codec) can 
+		not be served in place and are refused.
+		returns true if error, false if success.
+		will unmap any file currently mapped */
+	bool map( std::string filename );
+	void unmap();
+
+	/* get the number of rows, the min/max row numbers from the matrix */
+	size_t min() const { return mn; }
+	size_t max() const { return mn + rows.size() -1; }
+	size_t size() const { return rows.size(); }
+	bool empty() const { return rows.empty(); }
+	size_t values() const;
+
+	/* no bounds checking,
+		only use if row >= min() && row <= max() && !empty() */
+	const RowIndex& get_row( size_t row ) const { return rows[row - mn]; }
+
+	/* returns the value at row, col,
+		if row, col doesn't exist then will return defaultValue */
+	T get( size_t row, size_t col ) const;
+	T operator()( size_t row, size_t col ) const { return get( row, col ); }
+};
+
+template <typename T>
+bool OffsetMatrixView<T>::map( std::string filename )
+{
+	unmap();
+
+	const int fd = open( filename.c_str(), O_RDONLY );
+	if( fd < 0 ) return true;
+
+	struct stat info;
+	if( fstat( fd, &info ) != 0 || info.st_size <= 0 )
+	{
+		close( fd );
+		return true;
+	}
+
+	length = info.st_size;
+	mapping = mmap( nullptr, length, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd ); // the mapping keeps its own reference to the file
+
+	if( mapping == MAP_FAILED )
+	{
+		mapping = nullptr;
+		length = 0;
+		return true;
+	}
+
+	const char* buffer = static_cast<const char*>( mapping );
+	if( format::is_v2( buffer, length ) )
+	{
+		if( map_v2( buffer ) )
+		{
+			unmap();
+			return true;
+		}
+		return false;
+	}
+
+	size_t pos = 0;
+
+	// headers are not necessarily size_t aligned, so copy them out
+	auto read = [&]( size_t &val )
+	{
+		if( length - pos < sizeof(val) ) return false;
+		memcpy( &val, buffer + pos, sizeof(val) );
+		pos += sizeof(val);
+		return true;
+	};
+
+	// read the total values, the minimum row number and the number of rows
+	size_t total, rowsMin, rowsNum;
+	if( !read( total ) || !read( rowsMin ) || !read( rowsNum ) )
+	{
+		unmap();
+		return true;
+	}
+
+	mn = rowsMin;
+	rows.reserve( rowsNum );
+
+	// index every row, only the row headers are touched
+	for( size_t i=0; i<rowsNum; ++i )
+	{
+		RowIndex r;
+		if( !read( r.colsMin ) || !read( r.colsNum ) ||
+			 (length - pos) / sizeof(T) < r.colsNum )
+		{
+			unmap();
+			return true;
+		}
+
+		r.data = reinterpret_cast<const T*>( buffer + pos );
+		pos += sizeof(T) * r.colsNum;
+
+		rows.push_back( r );
+	}
+
+	return false;
+}
+
+template <typename T>
+bool OffsetMatrixView<T>::map_v2( const char* buffer )
+{
+	format::Header header;
+	if( length < sizeof(header) ) return true;
+	memcpy( &header, buffer, sizeof(header) );
+
+	if( format::check_header<T>( header ) ||
+		 header.tableOffset > length ||
+		 (length - header.tableOffset) / sizeof(format::RowEntry) < header.rowsNum )
+		return true;
+
+	// the row table is aligned so it can be used in place
+	const format::RowEntry* table = reinterpret_cast<const format::RowEntry*>( buffer + header.tableOffset );
+
+	mn = header.rowsMin;
+	rows.reserve( header.rowsNum );
+
+	for( size_t i=0; i<header.rowsNum; ++i )
+	{
+		const format::RowEntry &entry = table[i];
+		if( entry.codec != format::RAW || 
+			 entry.bytes != sizeof(T) * entry.colsNum ||
+			 entry.offset > length || length - entry.offset < entry.bytes )
+			return true;
+
+		RowIndex r;
+		r.colsMin = entry.colsMin;
+		r.colsNum = entry.colsNum;
+		r.data = reinterpret_cast<const T*>( buffer + entry.offset );
+
+		rows.push_back( r );
+	}
+
+	return false;
+}
+
+template <typename T>
+void OffsetMatrixView<T>::unmap()
+{
+	if( mapping ) munmap( mapping, length );
+
+	mapping = nullptr;
+	length = 0;
+	mn = 0;
+	rows.clear();
+}
+
+template <typename T>
+size_t OffsetMatrixView<T>::values() const
+{
+	size_t count = 0;
+	for( const RowIndex &r : rows )
+		count += r.colsNum;
+
+	return count;
+}
+
+template <typename T>
+T OffsetMatrixView<T>::get( size_t row, size_t col ) const
+{
+	if( row < min() || row > max() || empty() )
+		return defaultValue;
+
+	const RowIndex &r = get_row( row );
+	if( col < r.colsMin || col - r.colsMin >= r.colsNum )
+		return defaultValue;
+
+	return r.data[ col - r.colsMin ];
+}
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+#include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include "offsetmatrix.h"
+#include "offsetmatrixview.h"
+#include "offsettest.h"
+
+using namespace offset;
+
+class OffsetMatrixViewTest: public CxxTest::TestSuite
+{
+private:
+	std::string filename;
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		filename = "offsetmatrixview_test.bin";
+		defaultValue = 999;
+	}
+
+	void tearDown()
+	{
+		remove( filename.c_str() );
+	}
+
+	void test_missing_file()
+	{
+		OffsetMatrixView<int> view( defaultValue );
+
+		TS_ASSERT( view.map( "does_not_exist.bin" ) );
+		TS_ASSERT( view.empty() );
+	}
+
+	void test_map()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		TS_ASSERT( !store.save( filename ) );
+
+		OffsetMatrixView<int> view( defaultValue );
+		TS_ASSERT( !view.map( filename ) );
+
+		TS_ASSERT_EQUALS( store.min(), view.min() );
+		TS_ASSERT_EQUALS( store.max(), view.max() );
+		TS_ASSERT_EQUALS( store.values(), view.values() );
+
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( store.get(row, col), view.get(row, col) );
+	}
+
+	void test_truncated_file()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		store.set( 1, 1, 1 );
+		store.set( 2, 5, 1 );
+		TS_ASSERT( !store.save( filename ) );
+
+		TS_ASSERT_EQUALS( 0, truncate( filename.c_str(), 40 ) );
+
+		OffsetMatrixView<int> view( defaultValue );
+		TS_ASSERT( view.map( filename ) );
+		TS_ASSERT( view.empty() );
+	}
+	void test_map_v1()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		TS_ASSERT( !store.save_v1( filename ) );
+
+		OffsetMatrixView<int> view( defaultValue );
+		TS_ASSERT( !view.map( filename ) );
+
+		TS_ASSERT_EQUALS( store.values(), view.values() );
+		for( size_t row=0; row<30; ++row )
+			for( size_t col=0; col<50; ++col )
+				TS_ASSERT_EQUALS( store.get(row, col), view.get(row, col) );
+	}
+
+	void test_aligned_rows()
+	{
+		OffsetMatrix<char> store( 0 );
+		store.set( 1, 3, 1 );
+		store.set( 2, 5, 2 );
+		store.set( 3, 7, 3 );
+		TS_ASSERT( !store.save( filename ) );
+
+		OffsetMatrixView<char> view( 0 );
+		TS_ASSERT( !view.map( filename ) );
+
+		for( size_t row=view.min(); row<=view.max(); ++row )
+			TS_ASSERT_EQUALS( 0, (size_t)view.get_row(row).data % format::alignment );
+	}
+};
\ No newline at end of file
@@ -0,0 +1,186 @@
+#ifndef OFFSETPARALLEL_H
+#define OFFSETPARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if __cplusplus >= 201703L
+	#include <execution>
+	#include <numeric>
+#endif
+
+namespace offset
+{
+
+namespace parallel
+{
+
+/* number of threads to use when the caller asks for 0 */
+inline size_t default_threads()
+{
+	const size_t n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+/* split the indexes [0, n) into at most parts contiguous ranges of roughly
+	equal total weight, weight(i) gives the cost of index i.
+	returns the boundaries, range k is [bounds[k], bounds[k+1]) */
+template <typename Weight>
+std::vector<size_t> split( const size_t n, size_t parts, Weight weight )
+{
+	parts = std::max( std::min( parts, n ), (size_t)1 );
+
+	double total = 0;
+	for( size_t i=0; i<n; ++i )
+		total += weight( i );
+
+	std::vector<size_t> bounds( 1, 0 );
+	double sum = 0;
+	for( size_t i=0; i<n && bounds.size() < parts; ++i )
+	{
+		sum += weight( i );
+		if( sum >= total * bounds.size() / parts )
+			bounds.push_back( i+1 );
+	}
+
+	if( bounds.back() != n ) bounds.push_back( n );
+
+	return bounds;
+}
+
+/* call fn(i) for every i in [0, n) from threads threads.
+	each thread takes the next i from a shared counter, so uneven work
+	balances itself. with one thread everything runs on the caller */
+template <typename F>
+void for_each_index( const size_t n, size_t threads, F fn )
+{
+	if( threads == 0 ) threads = default_threads();
+	threads = std::min( threads, n );
+
+	if( threads <= 1 )
+	{
+		for( size_t i=0; i<n; ++i )
+			fn( i );
+		return;
+	}
+
+	std::atomic<size_t> next( 0 );
+	auto worker = [&]()
+	{
+		for( size_t i=next++; i<n; i=next++ )
+			fn( i );
+	};
+
+	std::vector<std::thread> pool;
+	for( size_t t=1; t<threads; ++t )
+		pool.emplace_back( worker );
+
+	worker(); // the caller does its share too
+
+	for( std::thread &t : pool )
+		t.join();
+}
+
+/* split the rows of matrix into at most parts ranges of roughly equal 
+	numbers of values, rather than of rows, so one long row doesn't leave 
+	every other thread waiting. bounds as split(), indexes from the first row */
+template <typename Matrix>
+std::vector<size_t> split_rows( const Matrix& matrix, const size_t parts )
+{
+	auto first = matrix.begin();
+	return split( matrix.size(), parts, [&first]( size_t i ) { return first[i].size() +1; } );
+}
+
+/* call fn(row, r) for every row r (with row number row) of matrix from 
+	threads threads, 0 for default_threads(). the rows are split into 4 
+	ranges per thread by split_rows() and threads take the next range as 
+	they finish one, so uneven ranges still balance out. fn may change the
+	values of r but not add or remove rows */
+template <typename Matrix, typename F>
+void for_each_row( Matrix& matrix, F fn, size_t threads=0 )
+{
+	if( threads == 0 ) threads = default_threads();
+
+	const std::vector<size_t> chunks = split_rows( matrix, threads*4 );
+	auto first = matrix.begin();
+	const size_t mn = matrix.min();
+
+	for_each_index( chunks.size() -1, threads, [&]( size_t chunk )
+	{
+		for( size_t i=chunks[chunk]; i<chunks[chunk+1]; ++i )
+			fn( mn + i, first[i] );
+	} );
+}
+
+/* replace every stored value v of matrix with fn(v), in parallel as 
+	for_each_row(). columns outside the rows are left as the default */
+template <typename Matrix, typename F>
+void transform( Matrix& matrix, F fn, size_t threads=0 )
+{
+	for_each_row( matrix, [&fn]( size_t, typename Matrix::Row& r )
+	{
+		for( auto &v : r )
+			v = fn( v );
+	}, threads );
+}
+
+/* combine( combine( init, map(row, r) ), ... ) over every row r of matrix.
+	rows are mapped and combined within each range of split_rows() in 
+	parallel, then the ranges are combined in row order, so combine only 
+	needs to be associative and the answer doesn't depend on the timing */
+template <typename Matrix, typename R, typename Map, typename Combine>
+R reduce( const Matrix& matrix, R init, Map map, Combine combine, size_t threads=0 )
+{
+	if( threads == 0 ) threads = default_threads();
+
+	const std::vector<size_t> chunks = split_rows( matrix, threads*4 );
+	auto first = matrix.begin();
+	const size_t mn = matrix.min();
+
+	// ranges are never empty
+	std::vector<R> partial( chunks.size() -1, init );
+	for_each_index( chunks.size() -1, threads, [&]( size_t chunk )
+	{
+		R r = map( mn + chunks[chunk], first[ chunks[chunk] ] );
+		for( size_t i=chunks[chunk] +1; i<chunks[chunk+1]; ++i )
+			r = combine( r, map( mn + i, first[i] ) );
+
+		partial[chunk] = r;
+	} );
+
+	for( const R &r : partial )
+		init = combine( init, r );
+
+	return init;
+}
+
+#if __cplusplus >= 201703L
+/* as for_each_row() with the ranges handed to std::for_each with policy, 
+	so the standard library (TBB with libstdc++) schedules the work */
+template <typename Policy, typename Matrix, typename F,
+		  typename = typename std::enable_if< std::is_execution_policy< typename std::decay<Policy>::type >::value >::type>
+void for_each_row( Policy&& policy, Matrix& matrix, F fn )
+{
+	const std::vector<size_t> chunks = split_rows( matrix, default_threads()*4 );
+	auto first = matrix.begin();
+	const size_t mn = matrix.min();
+
+	std::vector<size_t> ids( chunks.size() -1 );
+	std::iota( ids.begin(), ids.end(), (size_t)0 );
+
+	std::for_each( std::forward<Policy>( policy ), ids.begin(), ids.end(), [&]( size_t chunk )
+	{
+		for( size_t i=chunks[chunk]; i<chunks[chunk+1]; ++i )
+			fn( mn + i, first[i] );
+	} );
+}
+#endif
+
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include <cxxtest/TestSuite.h>
+#include <mutex>
+#include "offsetparallel.h"
+#include "offsetmatrix.h"
+
+using namespace offset;
+
+class OffsetParallelTest: public CxxTest::TestSuite
+{
+public:
+	void test_split()
+	{
+		// weights 1,1,1,1,4,4 split in two
+		std::vector<size_t> weights = {1,1,1,1,4,4};
+		auto bounds = parallel::split( weights.size(), 2, [&weights]( size_t i ) { return weights[i]; } );
+
+		TS_ASSERT_EQUALS( 3, bounds.size() );
+		TS_ASSERT_EQUALS( 0, bounds.front() );
+		TS_ASSERT_EQUALS( 5, bounds[1] );
+		TS_ASSERT_EQUALS( weights.size(), bounds.back() );
+	}
+
+	void test_split_small()
+	{
+		auto one = []( size_t ) { return 1; };
+
+		// never more ranges than indexes
+		auto bounds = parallel::split( 3, 10, one );
+		TS_ASSERT_EQUALS( 4, bounds.size() );
+
+		bounds = parallel::split( 0, 10, one );
+		TS_ASSERT_EQUALS( 1, bounds.size() );
+	}
+
+	void test_for_each_index()
+	{
+		const size_t n = 1000;
+		std::vector<int> seen( n, 0 );
+
+		parallel::for_each_index( n, 4, [&seen]( size_t i ) { ++seen[i]; } );
+
+		for( size_t i=0; i<n; ++i )
+			TS_ASSERT_EQUALS( 1, seen[i] );
+	}
+
+	void test_split_rows()
+	{
+		// one row as long as all the others put together
+		OffsetMatrix<int> m( 0 );
+		for( size_t col=0; col<1000; ++col )
+			m.set( 0, col, 1 );
+		for( size_t row=1; row<=10; ++row )
+			m.set( row, 100, 1 );
+
+		// the long row gets a range to itself
+		auto bounds = parallel::split_rows( m, 2 );
+		TS_ASSERT_EQUALS( 3, bounds.size() );
+		TS_ASSERT_EQUALS( 1, bounds[1] );
+		TS_ASSERT_EQUALS( 11, bounds[2] );
+	}
+
+	void test_for_each_row()
+	{
+		OffsetMatrix<int> m( -1 );
+		for( size_t row=5; row<200; ++row )
+			for( size_t col=0; col<row % 17; ++col )
+				m.set( row, col, (int)(row + col) );
+
+		std::vector<int> seen( 200, 0 );
+		parallel::for_each_row( m, [&seen]( size_t row, OffsetMatrix<int>::Row &r ) 
+		{ 
+			++seen[row];
+			for( int &v : r )
+				v *= 2;
+		}, 4 );
+
+		for( size_t row=5; row<200; ++row )
+		{
+			TS_ASSERT_EQUALS( 1, seen[row] );
+			for( size_t col=0; col<row % 17; ++col )
+				TS_ASSERT_EQUALS( (int)(row + col) *2, m.get( row, col ) );
+		}
+
+		parallel::transform( m, []( int v ) { return v +1; }, 3 );
+		TS_ASSERT_EQUALS( (int)(10 + 3) *2 +1, m.get( 10, 3 ) );
+		TS_ASSERT_EQUALS( -1, m.get( 10, 15 ) );
+	}
+
+	void test_reduce()
+	{
+		OffsetMatrix<int> m( 0 );
+		for( size_t row=0; row<300; ++row )
+			for( size_t col=row; col<row +row % 23; ++col )
+				m.set( row, col, 1 );
+
+		for( size_t threads=1; threads<=8; threads*=2 )
+		{
+			const size_t values = parallel::reduce( m, (size_t)0,
+				[]( size_t, const OffsetMatrix<int>::Row &r ) { return r.size(); },
+				[]( size_t a, size_t b ) { return a + b; }, threads );
+			TS_ASSERT_EQUALS( m.values(), values );
+
+			// combined in row order whatever the timing
+			const std::vector<size_t> rows = parallel::reduce( m, std::vector<size_t>(),
+				[]( size_t row, const OffsetMatrix<int>::Row & ) { return std::vector<size_t>( 1, row ); },
+				[]( std::vector<size_t> a, const std::vector<size_t> &b ) 
+				{ 
+					a.insert( a.end(), b.begin(), b.end() ); 
+					return a; 
+				}, threads );
+			TS_ASSERT_EQUALS( m.size(), rows.size() );
+			TS_ASSERT( std::is_sorted( rows.begin(), rows.end() ) );
+		}
+
+		OffsetMatrix<int> empty( 0 );
+		TS_ASSERT_EQUALS( 7, parallel::reduce( empty, 7, 
+			[]( size_t, const OffsetMatrix<int>::Row &r ) { return (int)r.size(); },
+			[]( int a, int b ) { return a + b; } ) );
+	}
+};
@@ -0,0 +1,129 @@
+#ifndef OFFSETREDUCE_H
+#define OFFSETREDUCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define OFFSET_REDUCE_X86
+#endif
+
+namespace offset
+{
+
+/* reductions over a run of values, such as a row's data().
+	arithmetic types on x86 use kernels built for AVX2 or AVX-512 when the
+	cpu running the program has them, picked once at run time. everything
+	else (and x86 cpus without AVX2) uses the same kernels built for the
+	baseline instruction set, which is already SSE2 on x86-64 and NEON on
+	AArch64. the kernels only become vector code with optimisation on (-O2) */
+namespace reduce
+{
+
+static const size_t block = 64;  // values tested per block by count() and find_first()
+static const size_t lanes = 8;   // partial results kept by sum(), min() and max()
+
+/* type sum() adds up in, 64 bit integers and double */
+template <typename T, bool Integral = std::is_integral<T>::value, bool Float = std::is_floating_point<T>::value>
+struct sum_type { typedef T type; };
+
+template <typename T>
+struct sum_type<T, true, false> 
+{ 
+	typedef typename std::conditional< std::is_signed<T>::value, int64_t, uint64_t >::type type; 
+};
+
+template <typename T>
+struct sum_type<T, false, true> { typedef double type; };
+
+namespace generic
+{
+#define OFFSET_TARGET
+#include "offsetreducekernels.h"
+#undef OFFSET_TARGET
+}
+
+#if defined(OFFSET_REDUCE_X86)
+namespace avx2
+{
+#define OFFSET_TARGET __attribute__(( target( "avx2" ) ))
+#include "offsetreducekernels.h"
+#undef OFFSET_TARGET
+}
+
+namespace avx512
+{
+#define OFFSET_TARGET __attribute__(( target( "avx512f,avx512bw" ) ))
+#include "offsetreducekernels.h"
+#undef OFFSET_TARGET
+}
+#endif
+
+/* instruction sets the kernels are built for */
+enum Level
+{
+	GENERIC = 0,
+	AVX2 = 1,
+	AVX512 = 2
+};
+
+/* best instruction set this cpu supports, worked out on the first call */
+inline Level level()
+{
+#if defined(OFFSET_REDUCE_X86)
+	static const Level l = __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ) ? AVX512 :
+						   __builtin_cpu_supports( "avx2" ) ? AVX2 : GENERIC;
+	return l;
+#else
+	return GENERIC;
+#endif
+}
+
+#if defined(OFFSET_REDUCE_X86)
+	#define OFFSET_REDUCE_DISPATCH( kernel, ... ) \
+		if( std::is_arithmetic<T>::value ) \
+		{ \
+			switch( level() ) \
+			{ \
+			case AVX512: return avx512::kernel( __VA_ARGS__ ); \
+			case AVX2: return avx2::kernel( __VA_ARGS__ ); \
+			default: break; \
+			} \
+		} \
+		return generic::kernel( __VA_ARGS__ );
+#else
+	#define OFFSET_REDUCE_DISPATCH( kernel, ... ) return generic::kernel( __VA_ARGS__ );
+#endif
+
+/* number of the n values equal to val */
+template <typename T>
+size_t count( const T* data, const size_t n, const T& val ) { OFFSET_REDUCE_DISPATCH( count, data, n, val ) }
+
+/* number of the n values not equal to val */
+template <typename T>
+size_t count_not( const T* data, const size_t n, const T& val ) { return n - count( data, n, val ); }
+
+/* sum of the n values in sum_type<T>, floating point values are added in 
+	a different order than a plain loop so the last bits may differ */
+template <typename T>
+typename sum_type<T>::type sum( const T* data, const size_t n ) { OFFSET_REDUCE_DISPATCH( sum, data, n ) }
+
+/* smallest/largest of the n values, n must be at least 1 */
+template <typename T>
+T min( const T* data, const size_t n ) { OFFSET_REDUCE_DISPATCH( min, data, n ) }
+
+template <typename T>
+T max( const T* data, const size_t n ) { OFFSET_REDUCE_DISPATCH( max, data, n ) }
+
+/* index of the first of the n values equal to val, or n if there isn't one */
+template <typename T>
+size_t find_first( const T* data, const size_t n, const T& val ) { OFFSET_REDUCE_DISPATCH( find_first, data, n, val ) }
+
+#undef OFFSET_REDUCE_DISPATCH
+
+}
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include <cxxtest/TestSuite.h>
+#include <algorithm>
+#include <numeric>
+#include "offsetreduce.h"
+
+using namespace offset;
+
+class OffsetReduceTest: public CxxTest::TestSuite
+{
+private:
+	/* check every kernel over the first n values against a plain loop */
+	template <typename T>
+	void check( const std::vector<T> &values, const T &val )
+	{
+		for( size_t n : { (size_t)0, (size_t)1, (size_t)7, (size_t)64, (size_t)65, values.size() } )
+		{
+			const T* data = values.data();
+			const size_t expected = std::count( data, data + n, val );
+
+			TS_ASSERT_EQUALS( reduce::count( data, n, val ), expected );
+			TS_ASSERT_EQUALS( reduce::count_not( data, n, val ), n - expected );
+			TS_ASSERT_EQUALS( reduce::find_first( data, n, val ), (size_t)(std::find( data, data + n, val ) - data) );
+			TS_ASSERT_EQUALS( reduce::sum( data, n ), 
+				std::accumulate( data, data + n, (typename reduce::sum_type<T>::type)0 ) );
+
+			if( n == 0 ) continue;
+			TS_ASSERT_EQUALS( reduce::min( data, n ), *std::min_element( data, data + n ) );
+			TS_ASSERT_EQUALS( reduce::max( data, n ), *std::max_element( data, data + n ) );
+		}
+	}
+
+public:
+	void test_int()
+	{
+		std::vector<int> values;
+		for( int i=0; i<1000; ++i )
+			values.push_back( (i * 7919) % 201 - 100 );
+
+		check( values, 42 );
+		check( values, 12345 );
+	}
+
+	void test_types()
+	{
+		std::vector<unsigned char> bytes;
+		std::vector<int64_t> longs;
+		std::vector<double> doubles;
+		for( int i=0; i<500; ++i )
+		{
+			bytes.push_back( i % 251 );
+			longs.push_back( (int64_t)i * i - 100000 );
+			doubles.push_back( i % 13 * 0.5 ); // exact so that any order of the sum agrees
+		}
+
+		check( bytes, (unsigned char)250 );
+		check( longs, (int64_t)-99999 );
+		check( doubles, 6.0 );
+
+		TS_ASSERT_EQUALS( reduce::sum( bytes.data(), bytes.size() ), 
+			std::accumulate( bytes.begin(), bytes.end(), (uint64_t)0 ) );
+	}
+
+	void test_levels()
+	{
+		// every kernel build this cpu can run gives the same answers
+		std::vector<int> values;
+		for( int i=0; i<777; ++i )
+			values.push_back( i % 100 );
+
+		const size_t n = values.size();
+		const size_t count = reduce::generic::count( values.data(), n, 42 );
+		const int64_t sum = reduce::generic::sum( values.data(), n );
+		TS_ASSERT_EQUALS( count, 8 );
+		TS_ASSERT_EQUALS( reduce::generic::find_first( values.data(), n, 42 ), 42 );
+
+#if defined(OFFSET_REDUCE_X86)
+		if( reduce::level() >= reduce::AVX2 )
+		{
+			TS_ASSERT_EQUALS( reduce::avx2::count( values.data(), n, 42 ), count );
+			TS_ASSERT_EQUALS( reduce::avx2::sum( values.data(), n ), sum );
+			TS_ASSERT_EQUALS( reduce::avx2::max( values.data(), n ), 99 );
+		}
+		if( reduce::level() >= reduce::AVX512 )
+		{
+			TS_ASSERT_EQUALS( reduce::avx512::count( values.data(), n, 42 ), count );
+			TS_ASSERT_EQUALS( reduce::avx512::sum( values.data(), n ), sum );
+			TS_ASSERT_EQUALS( reduce::avx512::min( values.data(), n ), 0 );
+		}
+#endif
+	}
+};
@@ -0,0 +1,107 @@
+/* reduction kernels, included by offsetreduce.h once for each instruction
+	set inside its own namespace with OFFSET_TARGET set to the matching
+	target attribute, so there is deliberately no include guard.
+	the loops are written in fixed size blocks that the compiler turns
+	into vector code for whatever OFFSET_TARGET allows */
+
+template <typename T>
+OFFSET_TARGET size_t count( const T* data, const size_t n, const T val )
+{
+	size_t c = 0, i = 0;
+
+	// a narrow counter per block lets the compares fill whole vectors
+	for( ; i + block <= n; i += block )
+	{
+		uint32_t b = 0;
+		for( size_t j=0; j<block; ++j )
+			b += data[i+j] == val;
+		c += b;
+	}
+
+	for( ; i<n; ++i )
+		c += data[i] == val;
+
+	return c;
+}
+
+template <typename T>
+OFFSET_TARGET typename sum_type<T>::type sum( const T* data, const size_t n )
+{
+	typedef typename sum_type<T>::type S;
+
+	// independent partial sums, one per vector lane
+	S partial[lanes] = {};
+	size_t i = 0;
+	for( ; i + lanes <= n; i += lanes )
+		for( size_t j=0; j<lanes; ++j )
+			partial[j] += data[i+j];
+
+	S s = 0;
+	for( size_t j=0; j<lanes; ++j )
+		s += partial[j];
+	for( ; i<n; ++i )
+		s += data[i];
+
+	return s;
+}
+
+template <typename T>
+OFFSET_TARGET T min( const T* data, const size_t n )
+{
+	T partial[lanes];
+	for( size_t j=0; j<lanes; ++j )
+		partial[j] = data[0];
+
+	size_t i = 0;
+	for( ; i + lanes <= n; i += lanes )
+		for( size_t j=0; j<lanes; ++j )
+			partial[j] = data[i+j] < partial[j] ? data[i+j] : partial[j];
+
+	T m = partial[0];
+	for( size_t j=1; j<lanes; ++j )
+		m = partial[j] < m ? partial[j] : m;
+	for( ; i<n; ++i )
+		m = data[i] < m ? data[i] : m;
+
+	return m;
+}
+
+template <typename T>
+OFFSET_TARGET T max( const T* data, const size_t n )
+{
+	T partial[lanes];
+	for( size_t j=0; j<lanes; ++j )
+		partial[j] = data[0];
+
+	size_t i = 0;
+	for( ; i + lanes <= n; i += lanes )
+		for( size_t j=0; j<lanes; ++j )
+			partial[j] = partial[j] < data[i+j] ? data[i+j] : partial[j];
+
+	T m = partial[0];
+	for( size_t j=1; j<lanes; ++j )
+		m = m < partial[j] ? partial[j] : m;
+	for( ; i<n; ++i )
+		m = m < data[i] ? data[i] : m;
+
+	return m;
+}
+
+template <typename T>
+OFFSET_TARGET size_t find_first( const T* data, const size_t n, const T val )
+{
+	// test whole blocks without branching, then find the value in the block that has it
+	size_t i = 0;
+	for( ; i + block <= n; i += block )
+	{
+		uint32_t hit = 0;
+		for( size_t j=0; j<block; ++j )
+			hit |= data[i+j] == val;
+		if( hit ) break;
+	}
+
+	for( ; i<n; ++i )
+		if( data[i] == val ) return i;
+
+	return n;
+}
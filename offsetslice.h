@@ -0,0 +1,119 @@
+#ifndef OFFSETSLICE_H
+#define OFFSETSLICE_H
+
+#include <algorithm>
+#include <cstddef>
+
+namespace offset
+{
+
+/* read only window over the columns lo to hi (inclusive) of a row, see
+	OffsetVector::subspan(). nothing is copied, the part of the window that
+	is stored is handed out as a pointer range and the columns either side
+	of it are defaultValue without being stored anywhere. only valid until
+	the row changes */
+template <typename T>
+class OffsetSpan
+{
+private:
+	size_t lo, hi;
+	size_t first;         // column of vals[0]
+	const T* vals;
+	size_t n;
+
+public:
+	T defaultValue;
+
+	/* the window lo to hi, of which n values starting at column first are stored in values */
+	OffsetSpan( size_t lo, size_t hi, size_t first, const T* values, size_t n, const T& defaultValue ) :
+		lo(lo), hi(hi), first(first), vals(values), n(n), defaultValue(defaultValue) {}
+
+	/* the columns of the window */
+	size_t min() const { return lo; }
+	size_t max() const { return hi; }
+	size_t size() const { return hi < lo ? 0 : hi - lo +1; }
+	bool empty() const { return size() == 0; }
+
+	/* the stored values inside the window, columns stored_min() to
+		stored_min() + stored_size() -1 */
+	size_t stored_min() const { return first; }
+	size_t stored_size() const { return n; }
+	const T* data() const { return vals; }
+	const T* begin() const { return vals; }
+	const T* end() const { return vals + n; }
+
+	/* number of defaultValue columns before and after the stored values */
+	size_t front_padding() const { return n == 0 ? size() : first - lo; }
+	size_t back_padding() const { return size() - front_padding() - n; }
+
+	/* returns the value in column col, defaultValue if it isn't stored
+		or is outside the window */
+	T get( size_t col ) const { return col - first < n ? vals[ col - first ] : defaultValue; }
+	T operator[]( size_t col ) const { return get( col ); }
+};
+
+/* read only window over the rows rowLo to rowHi and the columns colLo to
+	colHi (inclusive) of a matrix with dense rows, see OffsetMatrix::slice().
+	nothing is copied, each row of the window is an OffsetSpan into the
+	matrix. only valid until the matrix changes */
+template <typename T, typename Row>
+class OffsetMatrixSlice
+{
+private:
+	size_t rowLo, rowHi, colLo, colHi;
+	size_t first;          // row number of rows[0]
+	const Row* rows;
+	size_t n;
+
+public:
+	T defaultValue;
+
+	/* the window, of which n rows starting at row number first are stored in rows */
+	OffsetMatrixSlice( size_t rowLo, size_t rowHi, size_t colLo, size_t colHi,
+					   size_t first, const Row* rows, size_t n, const T& defaultValue ) :
+		rowLo(rowLo), rowHi(rowHi), colLo(colLo), colHi(colHi),
+		first(first), rows(rows), n(n), defaultValue(defaultValue) {}
+
+	/* the rows of the window */
+	size_t min() const { return rowLo; }
+	size_t max() const { return rowHi; }
+	size_t size() const { return rowHi < rowLo ? 0 : rowHi - rowLo +1; }
+	bool empty() const { return size() == 0; }
+
+	/* the columns of the window */
+	size_t col_min() const { return colLo; }
+	size_t col_max() const { return colHi; }
+
+	/* the rows of the window that exist in the matrix,
+		stored_min() to stored_min() + stored_size() -1 */
+	size_t stored_min() const { return first; }
+	size_t stored_size() const { return n; }
+
+	/* the columns of the window in row,
+		nothing is stored for a row that doesn't exist in the matrix */
+	OffsetSpan<T> get_row( size_t row ) const
+	{
+		if( row - first >= n ) return OffsetSpan<T>( colLo, colHi, colLo, nullptr, 0, defaultValue );
+
+		return rows[ row - first ].subspan( colLo, colHi, defaultValue );
+	}
+
+	/* returns the value at row, col, defaultValue if it isn't stored or
+		is outside the window */
+	T get( size_t row, size_t col ) const
+	{
+		return col >= colLo && col <= colHi ? get_row( row ).get( col ) : defaultValue;
+	}
+
+	/* call fn(row, span) for every row of the window that exists in the matrix */
+	template <typename F>
+	void for_each_row( F fn ) const
+	{
+		for( size_t i=0; i<n; ++i )
+			fn( first + i, rows[i].subspan( colLo, colHi, defaultValue ) );
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <cxxtest/TestSuite.h>
+#include <numeric>
+#include "offsetmatrix.h"
+#include "offsetslice.h"
+#include "offsettest.h"
+#include "offsetvector.h"
+
+using namespace offset;
+
+class OffsetSliceTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_subspan()
+	{
+		std::vector<int> values( 10 );
+		std::iota( values.begin(), values.end(), 1 );
+		OffsetVector<int> vect( 100, values.begin(), values.end(), defaultValue );
+
+		// overlapping the start of the vector
+		OffsetSpan<int> span = vect.subspan( 95, 102 );
+		TS_ASSERT_EQUALS( span.size(), 8 );
+		TS_ASSERT_EQUALS( span.stored_min(), 100 );
+		TS_ASSERT_EQUALS( span.stored_size(), 3 );
+		TS_ASSERT_EQUALS( span.data(), vect.data() );
+		TS_ASSERT_EQUALS( span.front_padding(), 5 );
+		TS_ASSERT_EQUALS( span.back_padding(), 0 );
+		TS_ASSERT_EQUALS( span.get( 95 ), defaultValue );
+		TS_ASSERT_EQUALS( span.get( 101 ), 2 );
+		TS_ASSERT_EQUALS( std::accumulate( span.begin(), span.end(), 0 ), 1 + 2 + 3 );
+
+		// inside it
+		span = vect.subspan( 103, 105 );
+		TS_ASSERT_EQUALS( span.data(), vect.data() + 3 );
+		TS_ASSERT_EQUALS( span.stored_size(), 3 );
+		TS_ASSERT_EQUALS( span.front_padding() + span.back_padding(), 0 );
+		TS_ASSERT_EQUALS( span[106], defaultValue );
+
+		// past the end
+		span = vect.subspan( 108, 120 );
+		TS_ASSERT_EQUALS( span.stored_size(), 2 );
+		TS_ASSERT_EQUALS( span.back_padding(), 11 );
+
+		// not overlapping at all
+		span = vect.subspan( 200, 210 );
+		TS_ASSERT_EQUALS( span.stored_size(), 0 );
+		TS_ASSERT_EQUALS( span.front_padding(), 11 );
+		TS_ASSERT_EQUALS( span.get( 205 ), defaultValue );
+		TS_ASSERT( span.begin() == span.end() );
+	}
+
+	void test_slice()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		OffsetMatrixSlice<int, OffsetMatrix<int>::Row> slice = store.slice( 5, 15, 14, 20 );
+		TS_ASSERT_EQUALS( slice.size(), 11 );
+		TS_ASSERT_EQUALS( slice.stored_min(), 10 );
+		TS_ASSERT_EQUALS( slice.stored_size(), 6 );
+
+		for( size_t row=0; row<25; ++row )
+			for( size_t col=0; col<40; ++col )
+			{
+				const bool inside = row >= 5 && row <= 15 && col >= 14 && col <= 20;
+				TS_ASSERT_EQUALS( slice.get( row, col ), inside ? store.get( row, col ) : defaultValue );
+			}
+
+		// rows point straight into the matrix
+		OffsetSpan<int> row = slice.get_row( 15 );
+		TS_ASSERT_EQUALS( row.data(), store.get_row( 15 ).data() );
+		TS_ASSERT_EQUALS( row.stored_size(), 20 - 15 +1 );
+		TS_ASSERT_EQUALS( slice.get_row( 7 ).stored_size(), 0 );
+
+		size_t rows = 0, values = 0;
+		slice.for_each_row( [&]( size_t, const OffsetSpan<int> &span )
+		{
+			++rows;
+			values += span.stored_size();
+		} );
+		TS_ASSERT_EQUALS( rows, 6 );
+		TS_ASSERT_EQUALS( values, 6 + 7 + 7 + 7 + 7 + 6 );
+
+		TS_ASSERT_EQUALS( store.slice( 30, 40, 0, 100 ).stored_size(), 0 );
+		TS_ASSERT_EQUALS( OffsetMatrix<int>( defaultValue ).slice( 0, 10, 0, 10 ).get( 1, 1 ), defaultValue );
+	}
+};
@@ -0,0 +1,273 @@
+#ifndef OFFSETSPARSEVECTOR_H
+#define OFFSETSPARSEVECTOR_H
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "offsetvector.h"
+
+namespace offset
+{
+
+/* row made of several dense runs of columns, sorted by column.
+	same get/set/min/max/is_in interface as OffsetVector but a new run is
+	started whenever a value would leave a gap of more than Gap default
+	values, so a row with values at columns 10 and 10,000,000 stores two
+	values rather than ten million. runs and their values use Alloc */
+template <typename T, size_t Gap=64, typename Alloc = std::allocator<T> >
+class OffsetSparseVector
+{
+public:
+	typedef Alloc allocator_type;
+	typedef OffsetVector<T, Alloc> Run;
+	typedef std::vector< Run, typename std::allocator_traits<Alloc>::template rebind_alloc<Run> > Runs;
+
+private:
+	Runs rs;
+	T defaultValue;
+
+	/* set() for both lvalues and rvalues, val is passed on to exactly one run */
+	template <typename V>
+	void store( const size_t col, V&& val, const T& defaultValue );
+
+	/* first run starting after col */
+	typename Runs::iterator after( const size_t col );
+	typename Runs::const_iterator after( const size_t col ) const;
+
+public:
+	// empty constructor
+	OffsetSparseVector( const T& defaultValue=T(), const Alloc& alloc=Alloc() ) : 
+		rs( alloc ), defaultValue(defaultValue) {}
+
+	Alloc get_allocator() const { return Alloc( rs.get_allocator() ); }
+
+	bool empty() const { return rs.empty(); }
+
+	/* number of values stored (including defaultValues inside runs) */
+	size_t size() const;
+
+	void clear() { rs.clear(); }
+
+	size_t min() const { return rs.empty() ? 0 : rs.front().min(); }
+	size_t max() const { return rs.empty() ? 0 : rs.back().max(); }
+
+	/* true if col is between min() and max(), it may still fall in a gap */
+	bool is_in( const size_t col ) const { return !empty() && col >= min() && col <= max(); }
+
+	/* the dense runs, in column order */
+	const Runs& runs() const { return rs; }
+
+	/* returned by find_first() when there is no such value */
+	static const size_t npos = -1;
+
+	/* reductions over the stored values of every run, see OffsetVector */
+	size_t count( const T& val ) const;
+	size_t count_not( const T& val ) const { return size() - count( val ); }
+	typename reduce::sum_type<T>::type sum() const;
+
+	/* smallest/largest stored value, only use if !empty() */
+	T min_value() const;
+	T max_value() const;
+
+	/* column of the first stored value equal to val, or npos */
+	size_t find_first( const T& val ) const;
+
+	/* get value currently stored in column col,
+		if no value is stored there then return defaultValue */
+	T get( const size_t col, const T& defaultValue ) const;
+	T get( const size_t col ) const { return get( col, defaultValue ); }
+
+	/* as get() without copying the value, see OffsetVector */
+	const T& get_ref( const size_t col, const T& defaultValue ) const;
+	const T& get_ref( const size_t col ) const { return get_ref( col, defaultValue ); }
+
+	/* pointer to the value stored in column col, nullptr if it falls outside every run */
+	T* find( const size_t col );
+	const T* find( const size_t col ) const;
+
+	/* compact every run, see OffsetVector, and drop the runs left empty */
+	void compact( const T& defaultValue );
+	void compact() { compact( defaultValue ); }
+
+	/* set the value in column col, extending or joining the runs either side
+		of it if they are close enough, otherwise starting a new run */
+	void set( const size_t col, const T& val, const T& defaultValue ) { store( col, val, defaultValue ); }
+	void set( const size_t col, const T& val ) { store( col, val, defaultValue ); }
+	void set( const size_t col, T&& val, const T& defaultValue ) { store( col, std::move( val ), defaultValue ); }
+	void set( const size_t col, T&& val ) { store( col, std::move( val ), defaultValue ); }
+};
+
+template <typename T, size_t Gap, typename Alloc>
+typename OffsetSparseVector<T, Gap, Alloc>::Runs::iterator OffsetSparseVector<T, Gap, Alloc>::after( const size_t col )
+{
+	return std::upper_bound( rs.begin(), rs.end(), col,
+		[]( const size_t c, const Run &r ) { return c < r.min(); } );
+}
+
+template <typename T, size_t Gap, typename Alloc>
+typename OffsetSparseVector<T, Gap, Alloc>::Runs::const_iterator OffsetSparseVector<T, Gap, Alloc>::after( const size_t col ) const
+{
+	return std::upper_bound( rs.begin(), rs.end(), col,
+		[]( const size_t c, const Run &r ) { return c < r.min(); } );
+}
+
+template <typename T, size_t Gap, typename Alloc>
+size_t OffsetSparseVector<T, Gap, Alloc>::size() const
+{
+	size_t s = 0;
+	for( const Run &r : rs )
+		s += r.size();
+
+	return s;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+size_t OffsetSparseVector<T, Gap, Alloc>::count( const T& val ) const
+{
+	size_t c = 0;
+	for( const Run &r : rs )
+		c += r.count( val );
+
+	return c;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+const size_t OffsetSparseVector<T, Gap, Alloc>::npos;
+
+template <typename T, size_t Gap, typename Alloc>
+typename reduce::sum_type<T>::type OffsetSparseVector<T, Gap, Alloc>::sum() const
+{
+	typename reduce::sum_type<T>::type s = 0;
+	for( const Run &r : rs )
+		s += r.sum();
+
+	return s;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+T OffsetSparseVector<T, Gap, Alloc>::min_value() const
+{
+	T m = rs.front().min_value();
+	for( const Run &r : rs )
+		m = std::min( m, r.min_value() );
+
+	return m;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+T OffsetSparseVector<T, Gap, Alloc>::max_value() const
+{
+	T m = rs.front().max_value();
+	for( const Run &r : rs )
+		m = std::max( m, r.max_value() );
+
+	return m;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+size_t OffsetSparseVector<T, Gap, Alloc>::find_first( const T& val ) const
+{
+	for( const Run &r : rs )
+	{
+		const size_t col = r.find_first( val );
+		if( col != Run::npos ) return col;
+	}
+
+	return npos;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+T OffsetSparseVector<T, Gap, Alloc>::get( const size_t col, const T& defaultValue ) const
+{
+	auto next = after( col );
+	if( next == rs.begin() ) return defaultValue;
+
+	return std::prev( next )->get( col, defaultValue );
+}
+
+template <typename T, size_t Gap, typename Alloc>
+const T& OffsetSparseVector<T, Gap, Alloc>::get_ref( const size_t col, const T& defaultValue ) const
+{
+	const T* val = find( col );
+
+	return val ? *val : defaultValue;
+}
+
+template <typename T, size_t Gap, typename Alloc>
+T* OffsetSparseVector<T, Gap, Alloc>::find( const size_t col )
+{
+	auto next = after( col );
+	if( next == rs.begin() ) return nullptr;
+
+	return std::prev( next )->find( col );
+}
+
+template <typename T, size_t Gap, typename Alloc>
+const T* OffsetSparseVector<T, Gap, Alloc>::find( const size_t col ) const
+{
+	auto next = after( col );
+	if( next == rs.begin() ) return nullptr;
+
+	return std::prev( next )->find( col );
+}
+
+template <typename T, size_t Gap, typename Alloc>
+void OffsetSparseVector<T, Gap, Alloc>::compact( const T& defaultValue )
+{
+	for( Run &r : rs )
+		r.compact( defaultValue );
+
+	rs.erase( std::remove_if( rs.begin(), rs.end(), []( const Run &r ) { return r.empty(); } ), rs.end() );
+	rs.shrink_to_fit();
+}
+
+template <typename T, size_t Gap, typename Alloc>
+template <typename V>
+void OffsetSparseVector<T, Gap, Alloc>::store( const size_t col, V&& val, const T& defaultValue )
+{
+	auto next = after( col );
+	auto prev = next == rs.begin() ? rs.end() : std::prev( next );
+
+	/* column is already inside a run */
+	if( prev != rs.end() && col <= prev->max() )
+	{
+		prev->set( col, std::forward<V>( val ), defaultValue );
+		return;
+	}
+
+	/* if val is the default value then don't both actually saving anything */
+	if( val == defaultValue ) return;
+
+	/* close enough to the end of the previous run to extend it,
+		join it with the next run if the gap between them is now small */
+	if( prev != rs.end() && col - prev->max() <= Gap +1 )
+	{
+		prev->set( col, std::forward<V>( val ), defaultValue );
+
+		if( next != rs.end() && next->min() - prev->max() <= Gap +1 )
+		{
+			const size_t offset = next->min() - prev->min();
+			prev->resize( next->max() - prev->min() +1, defaultValue );
+			std::move( next->begin(), next->end(), std::next( prev->begin(), offset ) );
+
+			rs.erase( next );
+		}
+	}
+	/* close enough to the start of the next run to extend it */
+	else if( next != rs.end() && next->min() - col <= Gap +1 )
+	{
+		next->set( col, std::forward<V>( val ), defaultValue );
+	}
+	/* too far from everything, start a new run */
+	else
+	{
+		Run r( defaultValue, get_allocator() );
+		r.set( col, std::forward<V>( val ), defaultValue );
+		rs.insert( next, std::move( r ) );
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include <cxxtest/TestSuite.h>
+#include <map>
+#include "offsetsparsevector.h"
+
+using namespace offset;
+
+class OffsetSparseVectorTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_empty()
+	{
+		OffsetSparseVector<int> vect( defaultValue );
+
+		TS_ASSERT( vect.empty() );
+		TS_ASSERT( !vect.is_in( 0 ) );
+		TS_ASSERT_EQUALS( defaultValue, vect.get( 42 ) );
+	}
+
+	void test_far_apart()
+	{
+		OffsetSparseVector<int> vect( defaultValue );
+
+		vect.set( 10, 1 );
+		vect.set( 10000000, 2 );
+
+		TS_ASSERT_EQUALS( 2, vect.runs().size() );
+		TS_ASSERT_EQUALS( 2, vect.size() );
+		TS_ASSERT_EQUALS( 10, vect.min() );
+		TS_ASSERT_EQUALS( 10000000, vect.max() );
+		TS_ASSERT( vect.is_in( 5000 ) );
+
+		TS_ASSERT_EQUALS( 1, vect.get( 10 ) );
+		TS_ASSERT_EQUALS( 2, vect.get( 10000000 ) );
+		TS_ASSERT_EQUALS( defaultValue, vect.get( 5000 ) );
+	}
+
+	void test_join()
+	{
+		OffsetSparseVector<int, 4> vect( defaultValue );
+
+		vect.set( 0, 1 );
+		vect.set( 20, 3 );
+		vect.set( 10, 2 );
+		TS_ASSERT_EQUALS( 3, vect.runs().size() );
+
+		// gaps of 4 or less are filled into the runs either side
+		vect.set( 5, 4 );
+		TS_ASSERT_EQUALS( 2, vect.runs().size() );
+		vect.set( 15, 5 );
+		TS_ASSERT_EQUALS( 1, vect.runs().size() );
+
+		TS_ASSERT_EQUALS( 1, vect.get( 0 ) );
+		TS_ASSERT_EQUALS( 4, vect.get( 5 ) );
+		TS_ASSERT_EQUALS( 2, vect.get( 10 ) );
+		TS_ASSERT_EQUALS( 5, vect.get( 15 ) );
+		TS_ASSERT_EQUALS( 3, vect.get( 20 ) );
+		TS_ASSERT_EQUALS( defaultValue, vect.get( 12 ) );
+		TS_ASSERT_EQUALS( 21, vect.size() );
+		TS_ASSERT_EQUALS( 16, vect.count( defaultValue ) );
+	}
+
+	void test_set()
+	{
+		std::map<size_t, int> expected;
+		OffsetSparseVector<int, 8> vect( defaultValue );
+
+		// pseudo random columns, some close together some far apart
+		size_t col = 12345;
+		for( int i=0; i<500; ++i )
+		{
+			col = (col * 1103515245 + 12345) % 100000;
+			vect.set( col, i );
+			expected[col] = i;
+		}
+
+		for( auto &e : expected )
+			TS_ASSERT_EQUALS( e.second, vect.get( e.first ) );
+
+		// runs stay sorted and apart
+		const auto &runs = vect.runs();
+		for( size_t i=1; i<runs.size(); ++i )
+			TS_ASSERT_LESS_THAN( runs[i-1].max() + 9, runs[i].min() );
+	}
+
+	void test_overwrite_default()
+	{
+		OffsetSparseVector<int> vect( defaultValue );
+
+		vect.set( 10, 1 );
+		vect.set( 10, defaultValue );
+
+		TS_ASSERT_EQUALS( defaultValue, vect.get( 10 ) );
+	}
+
+	void test_compact()
+	{
+		OffsetSparseVector<int, 4> vect( defaultValue );
+		vect.set( 10, 1 );
+		vect.set( 12, 2 );
+		vect.set( 1000, 3 );
+		vect.set( 2000, 4 );
+
+		vect.set( 10, defaultValue );
+		vect.set( 1000, defaultValue );
+		vect.compact();
+
+		TS_ASSERT_EQUALS( vect.runs().size(), 2 );
+		TS_ASSERT_EQUALS( vect.size(), 2 );
+		TS_ASSERT_EQUALS( vect.min(), 12 );
+		TS_ASSERT_EQUALS( vect.get( 12 ), 2 );
+		TS_ASSERT_EQUALS( vect.get( 2000 ), 4 );
+	}
+};
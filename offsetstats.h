@@ -0,0 +1,161 @@
+#ifndef OFFSETSTATS_H
+#define OFFSETSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(OFFSET_STATS)
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#endif
+
+namespace offset
+{
+
+/* where the memory of an OffsetMatrix goes, see OffsetMatrix::memory().
+	slots are values, used or spare, row headers are the Row objects
+	themselves (min, default value and the buffer pointers) */
+struct MemoryStats
+{
+	size_t rows = 0;               // rows in the matrix
+	size_t rowCapacity = 0;        // row headers allocated, including spare ones at either end
+	size_t values = 0;             // stored values, as values()
+	size_t capacity = 0;           // value slots allocated, including spare ones at either end
+	size_t defaults = 0;           // stored values equal to defaultValue
+
+	size_t headerBytes = 0;        // bytes of row headers allocated
+	size_t bytesUsed = 0;          // bytes of row headers and values in use
+	size_t bytesAllocated = 0;     // bytes of row headers and value slots allocated
+
+	/* fraction of stored values that are only filling the gaps between others */
+	double default_ratio() const { return values > 0 ? (double)defaults / values : 0; }
+
+	/* bytes of row header per row */
+	double row_overhead() const { return rows > 0 ? (double)headerBytes / rows : 0; }
+};
+
+namespace stats
+{
+
+/* event counters for every OffsetBuffer (so every row and row table) and
+	OffsetMatrix in the program. only counted when built with
+	-DOFFSET_STATS, otherwise counters() is always zero and nothing is
+	added to any buffer or call. the counters are relaxed atomics so
+	they can be read while other threads are working */
+struct Counters
+{
+	uint64_t backGrows = 0;        // reallocations to grow the back of a buffer
+	uint64_t frontGrows = 0;       // reallocations to grow the front of a buffer
+	uint64_t slides = 0;           // elements moved up inside an allocation instead
+	uint64_t elementsMoved = 0;    // elements copied or moved by the three above
+
+	uint64_t rowsBackGrows = 0;    // get_row() calls that added rows after max()
+	uint64_t rowsFrontGrows = 0;   // get_row() calls that added rows before min()
+
+	uint64_t saves = 0;            // save() calls
+	uint64_t saveNanos = 0;        // time spent in them
+	uint64_t loads = 0;            // load() calls
+	uint64_t loadNanos = 0;        // time spent in them
+};
+
+/* true if the counters are being counted */
+constexpr bool enabled()
+{
+#if defined(OFFSET_STATS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+#if defined(OFFSET_STATS)
+
+namespace detail
+{
+
+struct Atomics
+{
+	std::atomic<uint64_t> backGrows{ 0 }, frontGrows{ 0 }, slides{ 0 }, elementsMoved{ 0 };
+	std::atomic<uint64_t> rowsBackGrows{ 0 }, rowsFrontGrows{ 0 };
+	std::atomic<uint64_t> saves{ 0 }, saveNanos{ 0 }, loads{ 0 }, loadNanos{ 0 };
+};
+
+inline Atomics& atomics()
+{
+	static Atomics a;
+	return a;
+}
+
+/* adds one call and the time until it is destroyed to calls and nanos */
+class ScopedTimer
+{
+	std::atomic<uint64_t> &calls, &nanos;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+	ScopedTimer( std::atomic<uint64_t>& calls, std::atomic<uint64_t>& nanos ) : calls(calls), nanos(nanos) {}
+
+	~ScopedTimer()
+	{
+		calls.fetch_add( 1, std::memory_order_relaxed );
+		nanos.fetch_add( std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - start ).count(), std::memory_order_relaxed );
+	}
+};
+
+}
+
+/* add n to counter, time the rest of the enclosing scope as a save/load call */
+#define OFFSET_COUNT( counter, n ) \
+	offset::stats::detail::atomics().counter.fetch_add( (n), std::memory_order_relaxed )
+#define OFFSET_TIME( call ) \
+	offset::stats::detail::ScopedTimer offsetTimer( offset::stats::detail::atomics().call##s, \
+													offset::stats::detail::atomics().call##Nanos )
+
+/* copy of the counters so far */
+inline Counters counters()
+{
+	const detail::Atomics &a = detail::atomics();
+
+	Counters c;
+	c.backGrows = a.backGrows.load( std::memory_order_relaxed );
+	c.frontGrows = a.frontGrows.load( std::memory_order_relaxed );
+	c.slides = a.slides.load( std::memory_order_relaxed );
+	c.elementsMoved = a.elementsMoved.load( std::memory_order_relaxed );
+	c.rowsBackGrows = a.rowsBackGrows.load( std::memory_order_relaxed );
+	c.rowsFrontGrows = a.rowsFrontGrows.load( std::memory_order_relaxed );
+	c.saves = a.saves.load( std::memory_order_relaxed );
+	c.saveNanos = a.saveNanos.load( std::memory_order_relaxed );
+	c.loads = a.loads.load( std::memory_order_relaxed );
+	c.loadNanos = a.loadNanos.load( std::memory_order_relaxed );
+
+	return c;
+}
+
+/* set every counter back to zero */
+inline void reset()
+{
+	detail::Atomics &a = detail::atomics();
+
+	for( std::atomic<uint64_t>* c : { &a.backGrows, &a.frontGrows, &a.slides, &a.elementsMoved,
+									  &a.rowsBackGrows, &a.rowsFrontGrows,
+									  &a.saves, &a.saveNanos, &a.loads, &a.loadNanos } )
+		c->store( 0, std::memory_order_relaxed );
+}
+
+#else
+
+#define OFFSET_COUNT( counter, n ) ((void)0)
+#define OFFSET_TIME( call ) ((void)0)
+
+inline Counters counters() { return Counters(); }
+inline void reset() {}
+
+#endif
+
+}
+
+}
+
+#endif
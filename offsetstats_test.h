@@ -0,0 +1,126 @@
+// count in this test runner, see offsetstats.h
+#if !defined(OFFSET_STATS)
+#define OFFSET_STATS
+#endif
+
+#include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include "offsetmatrix.h"
+#include "offsetstats.h"
+#include "offsetvector.h"
+
+using namespace offset;
+
+class OffsetStatsTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+	std::string filename;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+		filename = "offsetstats_test.bin";
+		stats::reset();
+	}
+
+	void tearDown()
+	{
+		remove( filename.c_str() );
+	}
+
+	void test_memory()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		TS_ASSERT_EQUALS( store.memory().bytesUsed, 0 );
+		TS_ASSERT_EQUALS( store.memory().default_ratio(), 0 );
+
+		for( size_t row=10; row<20; ++row )
+		{
+			store.set( row, 0, 1 );
+			store.set( row, 99, 2 );
+		}
+
+		MemoryStats m = store.memory();
+		TS_ASSERT_EQUALS( m.rows, 10 );
+		TS_ASSERT_EQUALS( m.values, store.values() );
+		TS_ASSERT_EQUALS( m.values, 1000 );
+		TS_ASSERT_EQUALS( m.defaults, 1000 - 20 );
+		TS_ASSERT_EQUALS( m.default_ratio(), 0.98 );
+		TS_ASSERT_EQUALS( m.headerBytes, sizeof(OffsetMatrix<int>::Row) * m.rowCapacity );
+		TS_ASSERT_EQUALS( m.row_overhead(), (double)m.headerBytes / 10 );
+		TS_ASSERT_EQUALS( m.bytesUsed, sizeof(OffsetMatrix<int>::Row) * 10 + sizeof(int) * 1000 );
+		TS_ASSERT( m.rowCapacity >= m.rows );
+		TS_ASSERT( m.capacity >= m.values );
+		TS_ASSERT( m.bytesAllocated >= m.bytesUsed );
+
+		// nothing spare once compacted
+		store.set( 12, 0, defaultValue );
+		store.compact();
+		m = store.memory();
+		TS_ASSERT_EQUALS( m.rowCapacity, m.rows );
+		TS_ASSERT_EQUALS( m.capacity, m.values );
+		TS_ASSERT_EQUALS( m.bytesAllocated, m.bytesUsed );
+		TS_ASSERT_EQUALS( m.values, 1000 - 99 );
+	}
+
+	void test_counters()
+	{
+		TS_ASSERT( stats::enabled() );
+
+		// growing the back
+		OffsetVector<int> vect( defaultValue );
+		for( size_t col=1000; col<2000; ++col )
+			vect.set( col, 1, defaultValue );
+
+		stats::Counters c = stats::counters();
+		TS_ASSERT( c.backGrows > 0 );
+		TS_ASSERT_LESS_THAN( c.backGrows, 20 );
+		TS_ASSERT_EQUALS( c.frontGrows, 0 );
+
+		// growing the front is amortized too
+		stats::reset();
+		for( size_t col=1000; col-- > 0; )
+			vect.set( col, 2, defaultValue );
+
+		c = stats::counters();
+		TS_ASSERT( c.frontGrows + c.slides > 0 );
+		TS_ASSERT_LESS_THAN( c.frontGrows + c.slides, 20 );
+		TS_ASSERT_LESS_THAN( c.elementsMoved, 4 * 2000 );
+
+		// rows added either side of the matrix
+		stats::reset();
+		OffsetMatrix<int> store( defaultValue );
+		for( size_t row=10; row<20; ++row )
+			store.set( row, 5, 1 );
+		for( size_t row=10; row-- > 5; )
+			store.set( row, 5, 1 );
+
+		c = stats::counters();
+		TS_ASSERT_EQUALS( c.rowsBackGrows, 9 );
+		TS_ASSERT_EQUALS( c.rowsFrontGrows, 5 );
+
+		TS_ASSERT( !store.save( filename ) );
+		TS_ASSERT( !store.load( filename ) );
+		LoadOptions options;
+		options.threads = 2;
+		TS_ASSERT( !store.load( filename, options ) );
+
+		c = stats::counters();
+		TS_ASSERT_EQUALS( c.saves, 1 );
+		TS_ASSERT_EQUALS( c.loads, 2 );
+		TS_ASSERT( c.saveNanos > 0 );
+		TS_ASSERT( c.loadNanos > 0 );
+
+		// a version 1 file falls back to the plain load, counted once
+		TS_ASSERT( !store.save_v1( filename ) );
+		TS_ASSERT( !store.load( filename, options ) );
+		TS_ASSERT_EQUALS( stats::counters().loads, 3 );
+
+		stats::reset();
+		c = stats::counters();
+		TS_ASSERT_EQUALS( c.backGrows + c.frontGrows + c.slides + c.elementsMoved, 0 );
+		TS_ASSERT_EQUALS( c.saves + c.loads, 0 );
+	}
+};
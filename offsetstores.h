@@ -1,7 +1,20 @@
 #ifndef OFFSETSTORES_H
 #define OFFSETSTORES_H
 
+#include "offsetarena.h"
+#include "offsetstats.h"
 #include "offsetvector.h"
+#include "offsetsparsevector.h"
 #include "offsetmatrix.h"
+#include "offsetmatrixview.h"
+#include "offsetmatrixreader.h"
+#include "offsetmatrixiterator.h"
+#include "offsetmatrixbuilder.h"
+#include "offsetslice.h"
+#include "frozenoffsetmatrix.h"
+#include "concurrentoffsetmatrix.h"
+#include "versionedoffsetmatrix.h"
+#include "pagedoffsetmatrix.h"
+#include "tiledoffsetmatrix.h"
 
 #endif
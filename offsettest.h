@@ -0,0 +1,37 @@
+#ifndef OFFSETTEST_H
+#define OFFSETTEST_H
+
+#include <cstddef>
+
+namespace offset
+{
+
+/* setup shared by the test suites, not part of the library */
+namespace test
+{
+
+/* the value fill() stores at row, col */
+inline int value( size_t row, size_t col ) { return (int)(row*100 + col); }
+
+/* fn( row, col, value ) for rows first to last -1, row r taking columns
+	r to 2r -1, so every row starts and ends at a different column */
+template <typename F>
+void for_each_cell( F fn, size_t first=10, size_t last=20 )
+{
+	for( size_t row=first; row<last; ++row )
+		for( size_t col=row; col<row*2; ++col )
+			fn( row, col, value( row, col ) );
+}
+
+/* set the cells of for_each_cell() in store */
+template <typename Matrix>
+void fill( Matrix &store, size_t first=10, size_t last=20 )
+{
+	for_each_cell( [&store]( size_t row, size_t col, int val ) { store.set( row, col, val ); }, first, last );
+}
+
+}
+
+}
+
+#endif
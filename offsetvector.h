@@ -3,65 +3,108 @@
 
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "offsetbuffer.h"
+#include "offsetreduce.h"
+#include "offsetslice.h"
 
 namespace offset
 {
 
+/* default value policies for OffsetVector.
+	StoredDefault keeps the default value given on construction in every 
+	vector. ConstantDefault<T, Value> fixes it at compile time instead, it 
+	takes no space in the vector and compares against default values fold 
+	into constants. the value passed to the constructors is ignored */
 template <typename T>
-class OffsetVector : private std::vector<T>
+struct StoredDefault
+{
+	T defaultValue;
+
+	StoredDefault( const T& defaultValue ) : defaultValue(defaultValue) {}
+};
+
+template <typename T, T Value>
+struct ConstantDefault
+{
+	static constexpr T defaultValue = Value;
+
+	ConstantDefault( const T& ) {}
+};
+
+template <typename T, T Value>
+constexpr T ConstantDefault<T, Value>::defaultValue;
+
+template <typename T, typename Alloc = std::allocator<T>, typename Default = StoredDefault<T> >
+class OffsetVector : private OffsetBuffer<T, Alloc>, private Default
 {
 private:
 	size_t mn = 0;
-	T defaultValue;
+
+	using Default::defaultValue;
 
 public:
-	using std::vector<T>::front;
-	using std::vector<T>::back;
+	using OffsetBuffer<T, Alloc>::front;
+	using OffsetBuffer<T, Alloc>::back;
 	
-	using std::vector<T>::iterator;
-	using std::vector<T>::begin;
-	using std::vector<T>::end;
+	using OffsetBuffer<T, Alloc>::iterator;
+	using OffsetBuffer<T, Alloc>::begin;
+	using OffsetBuffer<T, Alloc>::end;
 	
-	using std::vector<T>::rbegin;
-	using std::vector<T>::rend;
+	using OffsetBuffer<T, Alloc>::rbegin;
+	using OffsetBuffer<T, Alloc>::rend;
 
-	using std::vector<T>::const_iterator;
-	using std::vector<T>::cbegin;
-	using std::vector<T>::cend;
+	using OffsetBuffer<T, Alloc>::const_iterator;
+	using OffsetBuffer<T, Alloc>::cbegin;
+	using OffsetBuffer<T, Alloc>::cend;
 	
-	using std::vector<T>::empty;
+	using OffsetBuffer<T, Alloc>::empty;
 	
-	using std::vector<T>::resize;
-	using std::vector<T>::size;
+	using OffsetBuffer<T, Alloc>::resize;
+	using OffsetBuffer<T, Alloc>::size;
+
+	using OffsetBuffer<T, Alloc>::data;
+
+	using OffsetBuffer<T, Alloc>::front_capacity;
+	using OffsetBuffer<T, Alloc>::back_capacity;
+	using OffsetBuffer<T, Alloc>::reserve_front;
+	using OffsetBuffer<T, Alloc>::shrink_to_fit;
 
-	using std::vector<T>::data;
+	typedef Alloc allocator_type;
+	typedef Default default_policy;
+	using OffsetBuffer<T, Alloc>::get_allocator;
 
 	// empty constructor
-	OffsetVector( const T& defaultValue=0 );
+	OffsetVector( const T& defaultValue=T(), const Alloc& alloc=Alloc() );
 
 	// constructor
-	OffsetVector( const size_t col, const size_t s, const T& defaultValue=0 );
+	OffsetVector( const size_t col, const size_t s, const T& defaultValue=T(), const Alloc& alloc=Alloc() );
 
 	// copy constructor
-	OffsetVector( const OffsetVector<T>& other );
+	OffsetVector( const OffsetVector<T, Alloc, Default>& other );
+
+	// move constructor
+	OffsetVector( OffsetVector<T, Alloc, Default>&& other ) noexcept;
 
 	// iterator constructor
 	template <typename iterator>
-	OffsetVector( const size_t col, iterator begin, iterator end, const T& defaultValue=0 ) : 
-		mn(col), defaultValue(defaultValue), std::vector<T>( begin, end ) {}
+	OffsetVector( const size_t col, iterator begin, iterator end, const T& defaultValue=T(), const Alloc& alloc=Alloc() ) : 
+		OffsetBuffer<T, Alloc>( begin, end, alloc ), Default(defaultValue), mn(col) {}
 
 	// destructor
 	~OffsetVector();
 
 	// copy assignment
-	OffsetVector<T>& operator=( const OffsetVector<T>& other );
+	OffsetVector<T, Alloc, Default>& operator=( const OffsetVector<T, Alloc, Default>& other );
 	// move assignment
-	OffsetVector<T>& operator=( OffsetVector<T>&& other ) noexcept;
+	OffsetVector<T, Alloc, Default>& operator=( OffsetVector<T, Alloc, Default>&& other ) noexcept;
 
 	void clear()
 	{
 		mn = 0;
-		std::vector<T>::clear();
+		OffsetBuffer<T, Alloc>::clear();
 	}
 
 	size_t min() const { return mn; }
@@ -69,127 +112,288 @@ public:
 
 	bool is_in( const size_t col ) const;
 
+	/* make sure columns lo to hi (inclusive) can be set without reallocating */
+	void reserve_range( const size_t lo, const size_t hi );
+
 	/* get value currently stored in column col,
 		if no value is stored there then return defaultValue */
 	T get( const size_t col, const T& defaultValue ) const;
 	T get( const size_t col ) const;
 
+	/* as get() without copying the value, the reference is to defaultValue
+		if nothing is stored in col. only valid until the vector changes */
+	const T& get_ref( const size_t col, const T& defaultValue ) const;
+	const T& get_ref( const size_t col ) const { return get_ref( col, defaultValue ); }
+
+	/* read only view of the columns lo to hi (inclusive) without copying,
+		the stored part of it is a pointer range into the vector */
+	OffsetSpan<T> subspan( const size_t lo, const size_t hi, const T& defaultValue ) const;
+	OffsetSpan<T> subspan( const size_t lo, const size_t hi ) const { return subspan( lo, hi, defaultValue ); }
+
+	/* no bounds checking, col is a column number rather than an offset.
+		only use if is_in( col ) && !empty() */
+	T& operator[]( const size_t col ) { return data()[ col - mn ]; }
+	const T& operator[]( const size_t col ) const { return data()[ col - mn ]; }
+
+	/* pointer to the value stored in column col, nullptr if col is out of range */
+	T* find( const size_t col ) { return is_in( col ) && !empty() ? &data()[ col - mn ] : nullptr; }
+	const T* find( const size_t col ) const { return is_in( col ) && !empty() ? &data()[ col - mn ] : nullptr; }
+
+	/* returned by find_first() when there is no such value */
+	static const size_t npos = -1;
+
+	/* reductions over the stored values (including any defaultValues 
+		between min() and max()), see offsetreduce.h */
+
+	/* number of stored values equal/not equal to val */
+	size_t count( const T& val ) const { return reduce::count( data(), size(), val ); }
+	size_t count_not( const T& val ) const { return reduce::count_not( data(), size(), val ); }
+	size_t count_not_default() const { return count_not( defaultValue ); }
+
+	typename reduce::sum_type<T>::type sum() const { return reduce::sum( data(), size() ); }
 
-	/* set the value in column col, if col is out of range then create it */
-	void set( const size_t col, const T val, const T& defaultValue );
-	void set( const size_t col, const T val );
+	/* smallest/largest stored value, only use if !empty() */
+	T min_value() const { return reduce::min( data(), size() ); }
+	T max_value() const { return reduce::max( data(), size() ); }
+
+	/* column of the first stored value equal to val, or npos */
+	size_t find_first( const T& val ) const;
+
+	/* remove the runs of defaultValue at either end and release the spare
+		capacity, the vector is empty if everything is defaultValue */
+	void compact( const T& defaultValue );
+	void compact() { compact( defaultValue ); }
+
+	/* set the value in column col, if col is out of range then create it.
+		val may be a value already stored in the vector */
+	void set( const size_t col, const T& val, const T& defaultValue );
+	void set( const size_t col, const T& val ) { set( col, val, defaultValue ); }
+
+	/* as above, moving val into place */
+	void set( const size_t col, T&& val, const T& defaultValue );
+	void set( const size_t col, T&& val ) { set( col, std::move( val ), defaultValue ); }
+
+	/* set column col to T( args... ), moved into place */
+	template <typename... Args>
+	void emplace( const size_t col, Args&&... args ) { set( col, T( std::forward<Args>( args )... ) ); }
+
+private:
+	/* make sure column col exists, filling new columns with defaultValue,
+		and return it */
+	T& make_slot( const size_t col, const T& defaultValue );
 };
 
-/*template <typename T>
+/*template <typename T, typename Alloc, typename Default>
 template <typename iterator>
-OffsetVector<T>::OffsetVector( const size_t col, iterator begin, iterator end )
+OffsetVector<T, Alloc, Default>::OffsetVector( const size_t col, iterator begin, iterator end )
 {
 
 }*/
 
 // empty constructor
-template <typename T>
-OffsetVector<T>::OffsetVector( const T& defaultValue ) : defaultValue(defaultValue), std::vector<T>() {}
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>::OffsetVector( const T& defaultValue, const Alloc& alloc ) : 
+	OffsetBuffer<T, Alloc>( alloc ), Default(defaultValue) {}
 
 // constructor
-template <typename T>
-OffsetVector<T>::OffsetVector( const size_t col, const size_t s, const T& defaultValue ) :
-	mn(col), std::vector<T>( s, defaultValue ) {}
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>::OffsetVector( const size_t col, const size_t s, const T& defaultValue, const Alloc& alloc ) :
+	OffsetBuffer<T, Alloc>( s, defaultValue, alloc ), Default(defaultValue), mn(col) {}
 
 // copy constructor
-template <typename T>
-OffsetVector<T>::OffsetVector( const OffsetVector<T>& other ) : mn( other.mn ), std::vector<T>( other ) {}
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>::OffsetVector( const OffsetVector<T, Alloc, Default>& other ) : 
+	OffsetBuffer<T, Alloc>( other ), Default( other ), mn( other.mn ) {}
+
+// move constructor
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>::OffsetVector( OffsetVector<T, Alloc, Default>&& other ) noexcept :
+	OffsetBuffer<T, Alloc>( std::move(other) ), Default( std::move(other) ), mn( other.mn )
+{
+	other.mn = 0;
+}
 
 // destructor
-template <typename T>
-OffsetVector<T>::~OffsetVector() {}
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>::~OffsetVector() {}
 
 // copy assignment
-template <typename T>
-OffsetVector<T>& OffsetVector<T>::operator=( const OffsetVector<T>& other )
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>& OffsetVector<T, Alloc, Default>::operator=( const OffsetVector<T, Alloc, Default>& other )
 {
 	mn = other.mn;
-	defaultValue = other.defaultValue;
-	std::vector<T>::operator=(other);
+	Default::operator=( other );
+	OffsetBuffer<T, Alloc>::operator=(other);
+
+	return *this;
 }
 
 // move assignment
-template <typename T>
-OffsetVector<T>& OffsetVector<T>::operator=( OffsetVector<T>&& other ) noexcept
+template <typename T, typename Alloc, typename Default>
+OffsetVector<T, Alloc, Default>& OffsetVector<T, Alloc, Default>::operator=( OffsetVector<T, Alloc, Default>&& other ) noexcept
 {
 	mn = std::move(other.mn);
-	defaultValue = std::move(other.defaultValue);
-	std::vector<T>::operator=( std::move(other) );
+	Default::operator=( std::move(other) );
+	OffsetBuffer<T, Alloc>::operator=( std::move(other) );
 
 	return *this;
 }
 
-template <typename T>
-bool OffsetVector<T>::is_in( const size_t col ) const 
+template <typename T, typename Alloc, typename Default>
+const size_t OffsetVector<T, Alloc, Default>::npos;
+
+template <typename T, typename Alloc, typename Default>
+size_t OffsetVector<T, Alloc, Default>::find_first( const T& val ) const
+{
+	const size_t i = reduce::find_first( data(), size(), val );
+
+	return i == size() ? npos : mn + i;
+}
+
+template <typename T, typename Alloc, typename Default>
+bool OffsetVector<T, Alloc, Default>::is_in( const size_t col ) const 
 { 
 	return col >= min() && col <= max(); 
 }
 
-template <typename T>
-T OffsetVector<T>::get( const size_t col, const T& defaultValue ) const
+template <typename T, typename Alloc, typename Default>
+void OffsetVector<T, Alloc, Default>::reserve_range( const size_t lo, const size_t hi )
+{
+	if( lo > hi ) return;
+
+	/* nothing stored yet, keep the whole range at the back of the buffer 
+		and remember where it starts */
+	if( this->empty() )
+	{
+		this->reset( 0 );
+		this->reserve_back( hi - lo +1 );
+		mn = lo;
+		return;
+	}
+
+	this->reserve( lo < min() ? min() - lo : 0, hi > max() ? hi - max() : 0 );
+}
+
+template <typename T, typename Alloc, typename Default>
+T OffsetVector<T, Alloc, Default>::get( const size_t col, const T& defaultValue ) const
 {
 	if( col < min() || col > max() || empty() ) return defaultValue;
 
-	return (*this)[ col - mn ];
+	return data()[ col - mn ];
 }
 
-template <typename T>
-T OffsetVector<T>::get( const size_t col ) const
+template <typename T, typename Alloc, typename Default>
+T OffsetVector<T, Alloc, Default>::get( const size_t col ) const
 {
 	return get( col, defaultValue );
 }
 
 
 
-template <typename T>
-void OffsetVector<T>::set( const size_t col, const T val, const T& defaultValue )
+template <typename T, typename Alloc, typename Default>
+const T& OffsetVector<T, Alloc, Default>::get_ref( const size_t col, const T& defaultValue ) const
+{
+	const T* val = find( col );
+
+	return val ? *val : defaultValue;
+}
+
+template <typename T, typename Alloc, typename Default>
+OffsetSpan<T> OffsetVector<T, Alloc, Default>::subspan( const size_t lo, const size_t hi, const T& defaultValue ) const
+{
+	if( empty() || lo > hi || hi < min() || lo > max() )
+		return OffsetSpan<T>( lo, hi, lo, nullptr, 0, defaultValue );
+
+	const size_t first = std::max( lo, min() );
+	const size_t last = std::min( hi, max() );
+
+	return OffsetSpan<T>( lo, hi, first, data() + (first - mn), last - first +1, defaultValue );
+}
+
+template <typename T, typename Alloc, typename Default>
+void OffsetVector<T, Alloc, Default>::compact( const T& defaultValue )
+{
+	const T* first = data();
+	const T* last = data() + size();
+
+	while( first != last && *first == defaultValue ) ++first;
+	while( last != first && *(last -1) == defaultValue ) --last;
+
+	if( first == last )
+	{
+		clear();
+	}
+	else
+	{
+		const size_t front = first - data();
+
+		resize( last - data() );
+		this->erase_front( front );
+		mn += front;
+	}
+
+	shrink_to_fit();
+}
+
+template <typename T, typename Alloc, typename Default>
+T& OffsetVector<T, Alloc, Default>::make_slot( const size_t col, const T& defaultValue )
 {
-	/* if val is the default value then don't both actually saving anything */
-	if( val == defaultValue ) return;
+	/* vector is currently empty,
+		place the element in any space reserved by reserve_range() otherwise
+		start again at the front of the buffer */
+	if( this->empty() )
+	{
+		const size_t slot = col + this->front_capacity() - mn;
+		const size_t slots = this->front_capacity() + this->back_capacity();
 
+		this->reset( col + this->front_capacity() >= mn && slot < slots ? slot : 0 );
+		this->resize( 1 );
+		mn = col;
+	}
 	/* column is greater than current max
 		resize vector to fit all fill new space with defaultValue */
-	if( col > max() )
+	else if( col > max() )
 	{
 		this->resize( col -mn +1, defaultValue );
 	}
 	/* column is less than current min
-		resize vector to fit, move current contents to back of vector,
-		fill front of vector with defaultValue */
+		grow the front of the vector into the headroom, 
+		fill new space with defaultValue */
 	else if( col < min() )
 	{
-		const size_t increase = min() - col;
-		const size_t originalSize = this->size();
+		this->grow_front( min() - col, defaultValue );
 
-		this->resize( this->size() + increase );
+		mn = col;
+	}
 
-		std::move_backward( this->begin(), next(this->begin(),originalSize), 
-								 this->end() );
+	return data()[ col - mn ];
+}
 
-		fill( next(this->begin()), next(this->begin(),increase), defaultValue );
+template <typename T, typename Alloc, typename Default>
+void OffsetVector<T, Alloc, Default>::set( const size_t col, const T& val, const T& defaultValue )
+{
+	/* if val is the default value then don't both actually saving anything,
+		unless it overwrites a value already stored */
+	if( val == defaultValue && (this->empty() || !is_in( col )) ) return;
 
-		mn = col;
-	}
-	/* vector is currently empty,
-		resize to fit one element */
-	else if( this->empty() )
+	/* val is one of our own values, growing could move it so copy it first */
+	const std::less<const T*> before;
+	if( !empty() && !before( &val, data() ) && before( &val, data() + size() ) )
 	{
-		mn = col;
-		this->resize( 1 );
+		T copy( val );
+		make_slot( col, defaultValue ) = std::move( copy );
+		return;
 	}
 
-	(*this)[ col - mn ] = val;
+	make_slot( col, defaultValue ) = val;
 }
 
-template <typename T>
-void OffsetVector<T>::set( const size_t col, const T val )
+template <typename T, typename Alloc, typename Default>
+void OffsetVector<T, Alloc, Default>::set( const size_t col, T&& val, const T& defaultValue )
 {
-	return set( col, val, defaultValue );
+	if( val == defaultValue && (this->empty() || !is_in( col )) ) return;
+
+	make_slot( col, defaultValue ) = std::move( val );
 }
 
 }
@@ -1,4 +1,5 @@
 #include <cxxtest/TestSuite.h>
+#include <string>
 #include "offsetvector.h"
 
 using namespace offset;
@@ -199,4 +200,232 @@ public:
 			TS_ASSERT_EQUALS( expectedValue, vect.get(pos) );
 		}
 	}
+
+	void test_set_reverse()
+	{
+		const size_t cols = 1000;
+
+		OffsetVector<int> vect( defaultValue );
+
+		// fill right to left, each set grows the front of the vector
+		for( size_t col=startingCol+cols; col-->startingCol; )
+		{
+			vect.set( col, (int)col*2 );
+			TS_ASSERT_EQUALS( col, vect.min() );
+		}
+
+		TS_ASSERT_EQUALS( cols, vect.size() );
+		TS_ASSERT_EQUALS( startingCol+cols-1, vect.max() );
+
+		for( size_t col=startingCol; col<startingCol+cols; ++col )
+			TS_ASSERT_EQUALS( (int)col*2, vect.get(col) );
+
+		// growing the front leaves gaps filled with the default value
+		vect.set( startingCol-10, 1 );
+		TS_ASSERT_EQUALS( 1, vect.get(startingCol-10) );
+		for( size_t col=startingCol-9; col<startingCol; ++col )
+			TS_ASSERT_EQUALS( defaultValue, vect.get(col) );
+	}
+
+	void test_reserve_front()
+	{
+		OffsetVector<int> vect( startingCol, testValues.begin(), testValues.end() );
+
+		vect.reserve_front( 20 );
+		TS_ASSERT_LESS_THAN_EQUALS( 20, vect.front_capacity() );
+
+		// reserving must not change the contents
+		TS_ASSERT_EQUALS( startingCol, vect.min() );
+		TS_ASSERT_EQUALS( testValues.size(), vect.size() );
+		for( size_t i=0; i<testValues.size(); ++i )
+			TS_ASSERT_EQUALS( testValues[i], vect.get(startingCol+i) );
+
+		const int *buffer = vect.data() + vect.size();
+		vect.set( startingCol-20, 1 );
+		TS_ASSERT_EQUALS( buffer, vect.data() + vect.size() ); // no reallocation
+	}
+
+	void test_reserve_range()
+	{
+		const size_t lo = 10, hi = 100;
+
+		OffsetVector<int> vect( defaultValue );
+		vect.reserve_range( lo, hi );
+
+		TS_ASSERT( vect.empty() );
+
+		vect.set( 50, 100 );
+		const int *buffer = vect.data() - (50 - lo);
+
+		for( size_t col=lo; col<=hi; ++col )
+			vect.set( col, (int)col*2 );
+
+		TS_ASSERT_EQUALS( buffer, vect.data() ); // no reallocation
+		TS_ASSERT_EQUALS( lo, vect.min() );
+		TS_ASSERT_EQUALS( hi, vect.max() );
+		for( size_t col=lo; col<=hi; ++col )
+			TS_ASSERT_EQUALS( (int)col*2, vect.get(col) );
+	}
+
+	void test_overwrite_default()
+	{
+		OffsetVector<int> vect( startingCol, testValues.begin(), testValues.end(), defaultValue );
+
+		// setting a stored value back to the default overwrites it
+		vect.set( startingCol+1, defaultValue );
+		TS_ASSERT_EQUALS( defaultValue, vect.get(startingCol+1) );
+		TS_ASSERT_EQUALS( testValues.size(), vect.size() );
+
+		// but setting the default outside the stored range stores nothing
+		vect.set( startingCol+100, defaultValue );
+		TS_ASSERT_EQUALS( testValues.size(), vect.size() );
+	}
+
+	void test_reductions()
+	{
+		OffsetVector<int> empty( defaultValue );
+		TS_ASSERT_EQUALS( empty.count( defaultValue ), 0 );
+		TS_ASSERT_EQUALS( empty.find_first( 1 ), OffsetVector<int>::npos );
+
+		// long enough to go through the block loops and the tail
+		std::vector<int> values;
+		for( size_t col=0; col<300; ++col )
+			values.push_back( col % 10 == 0 ? defaultValue : (int)col );
+
+		OffsetVector<int> vect( startingCol, values.begin(), values.end(), defaultValue );
+
+		TS_ASSERT_EQUALS( vect.count( defaultValue ), 30 );
+		TS_ASSERT_EQUALS( vect.count_not_default(), 270 );
+		TS_ASSERT_EQUALS( vect.count_not( 5 ), 299 );
+		TS_ASSERT_EQUALS( vect.min_value(), 1 );
+		TS_ASSERT_EQUALS( vect.max_value(), defaultValue );
+
+		int64_t sum = 0;
+		for( int val : vect )
+			sum += val;
+		TS_ASSERT_EQUALS( vect.sum(), sum );
+
+		TS_ASSERT_EQUALS( vect.find_first( 251 ), startingCol + 251 );
+		TS_ASSERT_EQUALS( vect.find_first( defaultValue ), startingCol );
+		TS_ASSERT_EQUALS( vect.find_first( -1 ), OffsetVector<int>::npos );
+	}
+
+	void test_move()
+	{
+		OffsetVector<std::string> vect( "" );
+		std::string value( 100, 'x' );
+
+		vect.set( 10, std::move( value ) );
+		vect.emplace( 12, 3, 'y' );
+		TS_ASSERT_EQUALS( vect.get( 10 ), std::string( 100, 'x' ) );
+		TS_ASSERT_EQUALS( vect.get( 11 ), "" );
+		TS_ASSERT_EQUALS( vect.get( 12 ), "yyy" );
+
+		// the default value set on construction is carried along
+		OffsetVector<std::string> copy( vect );
+		TS_ASSERT_EQUALS( copy.get( 12 ), "yyy" );
+		TS_ASSERT_EQUALS( copy.get( 50 ), "" );
+
+		OffsetVector<std::string> moved( std::move( copy ) );
+		TS_ASSERT_EQUALS( moved.min(), 10 );
+		TS_ASSERT_EQUALS( moved.get( 10 ), std::string( 100, 'x' ) );
+		TS_ASSERT( copy.empty() );
+		TS_ASSERT_EQUALS( copy.min(), 0 );
+
+		// setting a value already stored, in a column that makes the vector grow
+		vect.set( 1000, vect.get_ref( 10 ) );
+		vect.set( 1, *vect.find( 12 ) );
+		TS_ASSERT_EQUALS( vect.get( 1000 ), std::string( 100, 'x' ) );
+		TS_ASSERT_EQUALS( vect.get( 1 ), "yyy" );
+	}
+
+	void test_find()
+	{
+		OffsetVector<int> vect( startingCol, testValues.begin(), testValues.end(), defaultValue );
+
+		TS_ASSERT_EQUALS( vect.find( startingCol -1 ), nullptr );
+		TS_ASSERT_EQUALS( vect.find( startingCol + testValues.size() ), nullptr );
+		TS_ASSERT_EQUALS( *vect.find( startingCol ), testValues.front() );
+
+		*vect.find( startingCol ) = 42;
+		TS_ASSERT_EQUALS( vect.get( startingCol ), 42 );
+
+		TS_ASSERT_EQUALS( &vect.get_ref( startingCol ), vect.find( startingCol ) );
+		TS_ASSERT_EQUALS( vect.get_ref( startingCol -1 ), defaultValue );
+	}
+
+	void test_constant_default()
+	{
+		typedef OffsetVector<int, std::allocator<int>, ConstantDefault<int, -1> > ConstantVector;
+
+		TS_ASSERT_LESS_THAN( sizeof(ConstantVector), sizeof(OffsetVector<int>) );
+
+		ConstantVector vect;
+		vect.set( 10, -1 );
+		TS_ASSERT( vect.empty() );
+
+		vect.set( 10, 1 );
+		vect.set( 13, 4 );
+		TS_ASSERT_EQUALS( vect.size(), 4 );
+		TS_ASSERT_EQUALS( vect.get( 11 ), -1 );
+		TS_ASSERT_EQUALS( vect.get( 100 ), -1 );
+		TS_ASSERT_EQUALS( vect.get_ref( 5 ), -1 );
+		TS_ASSERT_EQUALS( vect.count_not_default(), 2 );
+
+		ConstantVector copy( vect );
+		TS_ASSERT_EQUALS( copy.get( 13 ), 4 );
+		TS_ASSERT_EQUALS( copy.get( 12 ), -1 );
+	}
+
+	void test_front_growth()
+	{
+		OffsetVector<int> vect( defaultValue );
+		for( size_t col=1000; col<1100; ++col )
+			vect.set( col, (int)col );
+
+		// with enough spare capacity at the back the values are moved up
+		// within the same allocation rather than into a new one
+		vect.reserve_range( 1000, 1400 );
+		const size_t capacity = vect.front_capacity() + vect.size() + vect.back_capacity();
+		vect.set( 990, 990 );
+		TS_ASSERT_EQUALS( vect.front_capacity() + vect.size() + vect.back_capacity(), capacity );
+		TS_ASSERT_EQUALS( vect.get( 990 ), 990 );
+		TS_ASSERT_EQUALS( vect.get( 1099 ), 1099 );
+
+		for( size_t col=900; col<1100; ++col )
+			vect.set( col, (int)col );
+		for( size_t col=900; col<1100; ++col )
+			TS_ASSERT_EQUALS( vect.get( col ), (int)col );
+
+		OffsetVector<std::string> strings( "" );
+		strings.set( 10, "ten" );
+		strings.set( 5, "five" );
+		TS_ASSERT_EQUALS( strings.get( 10 ), "ten" );
+		TS_ASSERT_EQUALS( strings.get( 5 ), "five" );
+	}
+
+	void test_compact()
+	{
+		OffsetVector<int> vect( startingCol, testValues.begin(), testValues.end(), defaultValue );
+		vect.set( startingCol, defaultValue );
+		vect.set( startingCol + testValues.size() -1, defaultValue );
+		vect.reserve_range( startingCol - 100, startingCol + 100 );
+
+		vect.compact();
+		TS_ASSERT_EQUALS( vect.min(), startingCol +1 );
+		TS_ASSERT_EQUALS( vect.size(), testValues.size() -2 );
+		TS_ASSERT_EQUALS( vect.front_capacity(), 0 );
+		TS_ASSERT_EQUALS( vect.back_capacity(), 0 );
+		for( size_t i=1; i<testValues.size() -1; ++i )
+			TS_ASSERT_EQUALS( vect.get( startingCol + i ), testValues[i] );
+
+		// nothing but defaultValues left
+		for( size_t col=vect.min(); col<=vect.max(); ++col )
+			vect.set( col, defaultValue );
+		vect.compact();
+		TS_ASSERT( vect.empty() );
+
+		vect.set( 5, 5 );
+		TS_ASSERT_EQUALS( vect.get( 5 ), 5 );
+	}
 };
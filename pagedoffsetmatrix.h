@@ -0,0 +1,403 @@
+#ifndef PAGEDOFFSETMATRIX_H
+#define PAGEDOFFSETMATRIX_H
+
+#include <list>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "offsetbuffer.h"
+#include "offsetformat.h"
+#include "offsetvector.h"
+
+namespace offset
+{
+
+/* counters for the row cache of a PagedOffsetMatrix */
+struct PagedStats
+{
+	size_t hits = 0;        // rows found in the cache
+	size_t misses = 0;      // rows read from the file (or created)
+	size_t evictions = 0;   // rows dropped from the cache
+	size_t writes = 0;      // dirty rows written back to the file
+};
+
+/* OffsetMatrix kept in a version 2 file (see offsetformat.h) with only
+	the recently used rows in memory.
+
+	rows are read from the file the first time they are used and kept in a
+	least recently used cache of at most budget bytes of values. once the
+	cache is full the least recently used rows are dropped, rows that have
+	been changed are written back to the file first. a row that still fits
+	in its old place in the file is written there, a longer one is written
+	after the last row, as is one sharing its place with other rows (see
+	SaveOptions::dedup). the row table and header are only written by
+	flush() and close(), the file is a normal save() file after either and
+	can be loaded, mapped or read as one.
+
+	get_row(), get() and set() behave as on OffsetMatrix, a row returned by
+	get_row() is only valid until the next call that may read a row.
+	not thread safe, not even get() */
+template <typename T>
+class PagedOffsetMatrix
+{
+	static_assert( std::is_trivially_copyable<T>::value, "values are paged as raw bytes" );
+
+public:
+	typedef OffsetVector<T> Row;
+
+private:
+	struct Slot
+	{
+		Row row;
+		bool dirty;
+		size_t bytes;                         // counted against the budget
+		std::list<size_t>::iterator used;     // position in lru
+	};
+
+	int fd = -1;
+	mutable bool failed = false;
+	size_t budget;
+
+	size_t mn = 0;
+	mutable OffsetBuffer<format::RowEntry> table;
+	mutable uint64_t end = sizeof(format::Header);  // where rows that don't fit are written
+	std::unordered_set<uint64_t> shared;            // payloads used by more than one row
+
+	mutable std::unordered_map<size_t, Slot> cache;
+	mutable std::list<size_t> lru;          // most recently used first
+	mutable size_t cached = 0;
+	mutable PagedStats counters;
+	mutable std::vector<char> scratch;
+
+	/* bytes a cached row counts against the budget */
+	static size_t row_bytes( const Row& r ) { return sizeof(Slot) + sizeof(T) * r.size(); }
+
+	/* the cache slot of row, reading it from the file if it isn't cached.
+		rows outside the table are empty */
+	Slot& fetch( size_t row ) const;
+
+	/* drop least recently used rows, except keep, until the cache fits the budget */
+	void evict( size_t keep ) const;
+
+	/* write a dirty row to the file and its table entry. returns true if error */
+	bool write_back( size_t row, Slot& s ) const;
+
+	/* count the current size of a cached row against the budget */
+	void recount( Slot& s ) const;
+
+	/* make sure row has a table entry */
+	void grow_table( size_t row );
+
+	format::RowEntry& entry( size_t row ) const { return table[row - mn]; }
+
+public:
+	T defaultValue;
+
+	/* budget is the number of bytes of rows to keep in memory */
+	PagedOffsetMatrix( const T& defaultValue, const size_t budget=64 << 20 ) : budget(budget), defaultValue(defaultValue) {}
+
+	PagedOffsetMatrix( const PagedOffsetMatrix<T>& other ) = delete;
+	PagedOffsetMatrix<T>& operator=( const PagedOffsetMatrix<T>& other ) = delete;
+
+	~PagedOffsetMatrix() { close(); }
+
+	/* open filename, a version 2 file of T written by save() or a
+		previous PagedOffsetMatrix, creating an empty matrix if the file
+		doesn't exist or is empty. returns true if error */
+	bool open( std::string filename );
+
+	/* write back every dirty row and then the row table and header.
+		returns true if error, including any error since the last flush() */
+	bool flush();
+
+	/* flush() and close the file. returns true if error */
+	bool close();
+
+	/* get the number of rows, the min/max row numbers from the matrix */
+	size_t min() const { return mn; }
+	size_t max() const { return mn + table.size() -1; }
+	size_t size() const { return table.size(); }
+	bool empty() const { return table.empty(); }
+	size_t values() const;
+
+	/* return a reference to row, reading it from the file or creating it
+		first. the row is treated as changed and written back on eviction */
+	Row& get_row( size_t row );
+
+	/* set the value at row, col */
+	void set( size_t row, size_t col, const T& val );
+
+	/* returns the value at row, col,
+		if row, col doesn't exist then will return defaultValue */
+	T get( size_t row, size_t col ) const;
+	T operator()( size_t row, size_t col ) const { return get( row, col ); }
+
+	/* rows and bytes currently held in memory */
+	size_t cached_rows() const { return cache.size(); }
+	size_t cached_bytes() const { return cached; }
+
+	const PagedStats& stats() const { return counters; }
+	void reset_stats() { counters = PagedStats(); }
+};
+
+template <typename T>
+bool PagedOffsetMatrix<T>::open( std::string filename )
+{
+	if( close() ) return true;
+	failed = false;
+
+	fd = ::open( filename.c_str(), O_RDWR | O_CREAT, 0644 );
+	if( fd < 0 ) return true;
+
+	mn = 0;
+	table.clear();
+	end = sizeof(format::Header);
+	shared.clear();
+
+	if( lseek( fd, 0, SEEK_END ) == 0 ) return false;
+
+	format::Header header;
+	std::vector<format::RowEntry> entries;
+	if( format::read_index<T>( fd, header, entries ) )
+	{
+		::close( fd );
+		fd = -1;
+		return true;
+	}
+
+	mn = header.rowsMin;
+	table.resize( entries.size() );
+	std::copy( entries.begin(), entries.end(), table.begin() );
+
+	std::unordered_set<uint64_t> seen;
+	for( const format::RowEntry &e : entries )
+	{
+		if( e.bytes == 0 ) continue;
+
+		end = std::max( end, e.offset + e.bytes );
+		if( !seen.insert( e.offset ).second ) shared.insert( e.offset );
+	}
+
+	return false;
+}
+
+template <typename T>
+bool PagedOffsetMatrix<T>::close()
+{
+	if( fd < 0 ) return false;
+
+	bool error = flush();
+	error |= ::close( fd ) != 0;
+	fd = -1;
+
+	cache.clear();
+	lru.clear();
+	cached = 0;
+
+	return error;
+}
+
+template <typename T>
+bool PagedOffsetMatrix<T>::flush()
+{
+	if( fd < 0 ) return true;
+
+	for( auto &c : cache )
+		if( c.second.dirty && write_back( c.first, c.second ) ) failed = true;
+
+	/* the table goes after the last row, rows written after this
+		overwrite it and the next flush() writes it again */
+	const uint64_t tableOffset = format::align( end );
+	const format::Header header = format::make_header<T>( values(), mn, size(), tableOffset );
+
+	if( !empty() && format::pwrite_all( fd, table.data(), sizeof(format::RowEntry) * size(), tableOffset ) ) failed = true;
+	if( format::pwrite_all( fd, &header, sizeof(header), 0 ) ) failed = true;
+	if( ftruncate( fd, tableOffset + sizeof(format::RowEntry) * size() ) != 0 ) failed = true;
+
+	const bool error = failed;
+	failed = false;
+
+	return error;
+}
+
+template <typename T>
+size_t PagedOffsetMatrix<T>::values() const
+{
+	size_t count = 0;
+	for( size_t i=0; i<size(); ++i )
+	{
+		auto c = cache.find( mn + i );
+		count += c == cache.end() ? table[i].colsNum : c->second.row.size();
+	}
+
+	return count;
+}
+
+template <typename T>
+typename PagedOffsetMatrix<T>::Slot& PagedOffsetMatrix<T>::fetch( size_t row ) const
+{
+	auto c = cache.find( row );
+	if( c != cache.end() )
+	{
+		++counters.hits;
+
+		Slot &s = c->second;
+		lru.splice( lru.begin(), lru, s.used );
+
+		// a row from get_row() may have changed size since it was last counted
+		recount( s );
+		evict( row );
+
+		return s;
+	}
+
+	++counters.misses;
+
+	Slot s{ Row( defaultValue ), false, 0, lru.end() };
+	if( row - mn < size() && entry( row ).colsNum > 0 )
+	{
+		const format::RowEntry &e = entry( row );
+		s.row = Row( e.colsMin, e.colsNum, defaultValue );
+		if( format::read_row( fd, e, s.row.data(), scratch ) )
+		{
+			failed = true;
+			s.row = Row( defaultValue );
+		}
+	}
+
+	lru.push_front( row );
+	s.used = lru.begin();
+	s.bytes = row_bytes( s.row );
+	cached += s.bytes;
+
+	Slot &slot = cache.emplace( row, std::move( s ) ).first->second;
+	evict( row );
+
+	return slot;
+}
+
+template <typename T>
+void PagedOffsetMatrix<T>::evict( size_t keep ) const
+{
+	while( cached > budget && !lru.empty() && lru.back() != keep )
+	{
+		const size_t row = lru.back();
+		auto c = cache.find( row );
+		Slot &s = c->second;
+
+		if( s.dirty && write_back( row, s ) ) failed = true;
+
+		cached -= s.bytes;
+		lru.pop_back();
+		cache.erase( c );
+		++counters.evictions;
+	}
+}
+
+template <typename T>
+void PagedOffsetMatrix<T>::recount( Slot& s ) const
+{
+	cached -= s.bytes;
+	s.bytes = row_bytes( s.row );
+	cached += s.bytes;
+}
+
+template <typename T>
+bool PagedOffsetMatrix<T>::write_back( size_t row, Slot& s ) const
+{
+	format::RowEntry &e = entry( row );
+	const uint64_t bytes = sizeof(T) * s.row.size();
+
+	/* rewrite the row where it was if it still fits, otherwise after the last row.
+		a payload shared with other rows (see SaveOptions::dedup) is left alone */
+	uint64_t offset = e.offset;
+	if( bytes > e.bytes || (e.bytes > 0 && shared.count( e.offset ) > 0) )
+	{
+		offset = format::align( end );
+		end = offset + bytes;
+	}
+
+	if( bytes > 0 && format::pwrite_all( fd, s.row.data(), bytes, offset ) ) return true;
+
+	e.colsMin = s.row.empty() ? 0 : s.row.min();
+	e.colsNum = s.row.size();
+	e.offset = bytes > 0 ? offset : 0;
+	e.bytes = bytes;
+	e.codec = format::RAW;
+
+	s.dirty = false;
+	++counters.writes;
+
+	return false;
+}
+
+template <typename T>
+void PagedOffsetMatrix<T>::grow_table( size_t row )
+{
+	format::RowEntry none;
+	memset( &none, 0, sizeof(none) );
+
+	if( table.empty() )
+	{
+		table.resize( 1, none );
+		mn = row;
+	}
+	else if( row > max() )
+	{
+		table.resize( row - mn +1, none );
+	}
+	else if( row < mn )
+	{
+		table.grow_front( mn - row, none );
+		mn = row;
+	}
+}
+
+template <typename T>
+typename PagedOffsetMatrix<T>::Row& PagedOffsetMatrix<T>::get_row( size_t row )
+{
+	grow_table( row );
+
+	Slot &s = fetch( row );
+	s.dirty = true;
+
+	return s.row;
+}
+
+template <typename T>
+void PagedOffsetMatrix<T>::set( size_t row, size_t col, const T& val )
+{
+	/* setting the default outside a row stores nothing, don't read the row for it */
+	if( val == defaultValue && (row - mn >= size() || entry( row ).colsNum == 0) && cache.find( row ) == cache.end() )
+		return;
+
+	grow_table( row );
+
+	Slot &s = fetch( row );
+	s.dirty = true;
+	s.row.set( col, val, defaultValue );
+
+	/* the row may have grown past the budget */
+	recount( s );
+	evict( row );
+}
+
+template <typename T>
+T PagedOffsetMatrix<T>::get( size_t row, size_t col ) const
+{
+	/* nothing to read for rows that aren't in the file or the cache */
+	if( row - mn >= size() || (entry( row ).colsNum == 0 && cache.find( row ) == cache.end()) ) 
+		return defaultValue;
+
+	return fetch( row ).row.get( col, defaultValue );
+}
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include <cxxtest/TestSuite.h>
+#include <cstdio>
+#include "offsetmatrix.h"
+#include "offsetmatrixview.h"
+#include "offsettest.h"
+#include "pagedoffsetmatrix.h"
+
+using namespace offset;
+
+class PagedOffsetMatrixTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+	std::string filename;
+
+	template <typename Matrix>
+	void check( const Matrix &store, const OffsetMatrix<int> &expected )
+	{
+		for( size_t row=0; row<70; ++row )
+			for( size_t col=0; col<130; ++col )
+				TS_ASSERT_EQUALS( store.get( row, col ), expected.get( row, col ) );
+	}
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+		filename = "pagedoffsetmatrix_test.bin";
+		remove( filename.c_str() );
+	}
+
+	void tearDown()
+	{
+		remove( filename.c_str() );
+	}
+
+	void test_create()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		test::fill( expected, 10, 60 );
+
+		PagedOffsetMatrix<int> paged( defaultValue, 2048 );
+		TS_ASSERT( !paged.open( filename ) );
+		TS_ASSERT( paged.empty() );
+
+		test::fill( paged, 10, 60 );
+
+		// only a few rows fit, the rest went to the file
+		TS_ASSERT( paged.cached_bytes() <= 2048 );
+		TS_ASSERT( paged.stats().evictions > 0 );
+		TS_ASSERT( paged.stats().writes > 0 );
+		TS_ASSERT_EQUALS( paged.min(), 10 );
+		TS_ASSERT_EQUALS( paged.max(), 59 );
+		TS_ASSERT_EQUALS( paged.values(), expected.values() );
+		check( paged, expected );
+
+		TS_ASSERT( !paged.close() );
+
+		// the file is a normal version 2 file
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load( filename ) );
+		check( loaded, expected );
+
+		OffsetMatrixView<int> view( defaultValue );
+		TS_ASSERT( !view.map( filename ) );
+		TS_ASSERT_EQUALS( view.get( 35, 40 ), 3540 );
+	}
+
+	void test_cache()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		test::fill( expected, 10, 60 );
+		TS_ASSERT( !expected.save( filename ) );
+
+		PagedOffsetMatrix<int> paged( defaultValue, 4096 );
+		TS_ASSERT( !paged.open( filename ) );
+		TS_ASSERT_EQUALS( paged.values(), expected.values() );
+		check( paged, expected );
+
+		const PagedStats stats = paged.stats();
+		TS_ASSERT_EQUALS( stats.writes, 0 );
+		TS_ASSERT( stats.misses >= 50 );
+		TS_ASSERT( stats.hits > 0 );
+
+		// a row in the cache is a hit
+		paged.get( 59, 60 );
+		paged.reset_stats();
+		paged.get( 59, 61 );
+		TS_ASSERT_EQUALS( paged.stats().hits, 1 );
+		TS_ASSERT_EQUALS( paged.stats().misses, 0 );
+
+		// rows that get longer move to the end of the file, shorter ones stay put
+		paged.set( 10, 100, 1 );
+		expected.set( 10, 100, 1 );
+		paged.set( 5, 3, 2 );
+		expected.set( 5, 3, 2 );
+		paged.get_row( 20 ).set( 21, 7 );
+		expected.set( 20, 21, 7 );
+
+		TS_ASSERT( !paged.flush() );
+		check( paged, expected );
+
+		TS_ASSERT( !paged.open( filename ) );
+		TS_ASSERT_EQUALS( paged.min(), 5 );
+		check( paged, expected );
+		TS_ASSERT( !paged.close() );
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load( filename ) );
+		TS_ASSERT_EQUALS( loaded.values(), expected.values() );
+		check( loaded, expected );
+	}
+
+	void test_shared_rows()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		for( size_t row=0; row<10; ++row )
+			for( size_t col=5; col<10; ++col )
+				expected.set( row, col, (int)col );
+
+		SaveOptions options;
+		options.dedup = true;
+		TS_ASSERT( !expected.save( filename, options ) );
+
+		// rewriting a shared row in place would change every row sharing it
+		{
+			PagedOffsetMatrix<int> paged( defaultValue, 0 );
+			TS_ASSERT( !paged.open( filename ) );
+			paged.set( 3, 6, 1 );
+			expected.set( 3, 6, 1 );
+			TS_ASSERT( !paged.close() );
+		}
+
+		OffsetMatrix<int> loaded( defaultValue );
+		TS_ASSERT( !loaded.load( filename ) );
+		check( loaded, expected );
+		TS_ASSERT_EQUALS( loaded.get( 2, 6 ), 6 );
+	}
+
+	void test_wrong_type()
+	{
+		OffsetMatrix<int> store( defaultValue );
+		test::fill( store, 10, 60 );
+		TS_ASSERT( !store.save( filename ) );
+
+		PagedOffsetMatrix<double> paged( 0 );
+		TS_ASSERT( paged.open( filename ) );
+	}
+};
@@ -0,0 +1,231 @@
+#ifndef TILEDOFFSETMATRIX_H
+#define TILEDOFFSETMATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "offsetmatrix.h"
+
+namespace offset
+{
+
+/* matrix stored as Tile x Tile blocks, for data that is mostly dense
+	inside a bounding box.
+
+	the values of a block sit row after row in one run of Tile * Tile
+	values, so a neighbourhood of a cell is a few contiguous runs, and
+	reading down a column is a fixed stride through the block instead of
+	a different row buffer for every row. blocks are found through an
+	OffsetMatrix of block numbers, one per Tile x Tile cells, which keeps
+	the offset semantics of OffsetMatrix for where the blocks are. Index
+	is the type of a block number, uint32_t halves the index for up to
+	4G blocks, and set() fails once none() blocks are in use.
+
+	a block is created, filled with defaultValue, the first time a value
+	that isn't defaultValue is set inside it, and stays until clear() */
+template <typename T, typename Index = size_t, size_t Tile = 64>
+class TiledOffsetMatrix
+{
+	static_assert( Tile > 0 && (Tile & (Tile -1)) == 0, "Tile must be a power of two" );
+	static_assert( std::numeric_limits<Index>::is_integer && !std::numeric_limits<Index>::is_signed,
+				   "Index must be an unsigned integer" );
+
+public:
+	static const size_t tile = Tile;
+	static const size_t tileSize = Tile * Tile;
+
+	/* block number of cells with no block */
+	static constexpr Index none() { return std::numeric_limits<Index>::max(); }
+
+private:
+	OffsetMatrix<Index> index;
+	std::vector<T> vals;          // the blocks, tileSize values each
+
+	/* the block holding row, col, none() if there isn't one */
+	Index find_block( size_t row, size_t col ) const;
+
+	/* first value of block b */
+	T* block( Index b ) { return vals.data() + tileSize * b; }
+	const T* block( Index b ) const { return vals.data() + tileSize * b; }
+
+	static size_t offset( size_t row, size_t col ) { return (row % Tile) * Tile + col % Tile; }
+
+public:
+	T defaultValue;
+
+	TiledOffsetMatrix( const T& defaultValue ) : index( none() ), defaultValue(defaultValue) {}
+
+	/* number of blocks and of values they hold, stored or default */
+	size_t blocks() const { return vals.size() / tileSize; }
+	size_t values() const { return vals.size(); }
+	bool empty() const { return vals.empty(); }
+
+	/* the rows and columns covered by the blocks, row_min() to row_max()
+		and col_min() to col_max(). only valid if !empty() */
+	size_t row_min() const { return index.min() * Tile; }
+	size_t row_max() const { return (index.max() +1) * Tile -1; }
+	size_t col_min() const;
+	size_t col_max() const;
+
+	/* bytes held by the blocks and the block index */
+	size_t memory() const { return sizeof(T) * vals.capacity() + index.memory().bytesAllocated; }
+
+	void clear()
+	{
+		index.clear();
+		vals.clear();
+	}
+
+	/* set the value at row, col.
+		returns true if error, when it needs a new block and every block
+		number below none() is taken, nothing is stored then */
+	bool set( size_t row, size_t col, const T& val );
+
+	/* returns the value at row, col,
+		if row, col doesn't exist then will return defaultValue */
+	T get( size_t row, size_t col ) const;
+	T operator()( size_t row, size_t col ) const { return get( row, col ); }
+
+	/* copy column col of rows rowLo to rowHi (inclusive) to out,
+		defaultValue where there is no block */
+	void get_column( size_t col, size_t rowLo, size_t rowHi, T* out ) const;
+
+	/* call fn(row, col, value) for every cell of rows rowLo to rowHi and
+		columns colLo to colHi (inclusive) that is inside a block, one block
+		at a time and row by row inside each */
+	template <typename F>
+	void for_each_in( size_t rowLo, size_t rowHi, size_t colLo, size_t colHi, F fn ) const;
+};
+
+template <typename T, typename Index, size_t Tile>
+const size_t TiledOffsetMatrix<T, Index, Tile>::tile;
+
+template <typename T, typename Index, size_t Tile>
+const size_t TiledOffsetMatrix<T, Index, Tile>::tileSize;
+
+template <typename T, typename Index, size_t Tile>
+Index TiledOffsetMatrix<T, Index, Tile>::find_block( size_t row, size_t col ) const
+{
+	const size_t blockRow = row / Tile;
+	if( index.empty() || blockRow < index.min() || blockRow > index.max() ) return none();
+
+	return index.get_row( blockRow ).get( col / Tile, none() );
+}
+
+template <typename T, typename Index, size_t Tile>
+size_t TiledOffsetMatrix<T, Index, Tile>::col_min() const
+{
+	size_t mn = std::numeric_limits<size_t>::max();
+	for( size_t r=index.min(); r<=index.max(); ++r )
+		if( !index.get_row( r ).empty() ) mn = std::min( mn, index.get_row( r ).min() );
+
+	return mn * Tile;
+}
+
+template <typename T, typename Index, size_t Tile>
+size_t TiledOffsetMatrix<T, Index, Tile>::col_max() const
+{
+	size_t mx = 0;
+	for( size_t r=index.min(); r<=index.max(); ++r )
+		if( !index.get_row( r ).empty() ) mx = std::max( mx, index.get_row( r ).max() );
+
+	return (mx +1) * Tile -1;
+}
+
+template <typename T, typename Index, size_t Tile>
+bool TiledOffsetMatrix<T, Index, Tile>::set( size_t row, size_t col, const T& val )
+{
+	Index b = find_block( row, col );
+	if( b == none() )
+	{
+		// setting the default where there is no block stores nothing
+		if( val == defaultValue ) return false;
+
+		// none() itself marks cells with no block
+		if( blocks() >= none() ) return true;
+
+		b = (Index)blocks();
+		vals.resize( vals.size() + tileSize, defaultValue );
+		index.set( row / Tile, col / Tile, b );
+	}
+
+	block( b )[ offset( row, col ) ] = val;
+	return false;
+}
+
+template <typename T, typename Index, size_t Tile>
+T TiledOffsetMatrix<T, Index, Tile>::get( size_t row, size_t col ) const
+{
+	const Index b = find_block( row, col );
+	if( b == none() ) return defaultValue;
+
+	return block( b )[ offset( row, col ) ];
+}
+
+template <typename T, typename Index, size_t Tile>
+void TiledOffsetMatrix<T, Index, Tile>::get_column( size_t col, size_t rowLo, size_t rowHi, T* out ) const
+{
+	for( size_t row=rowLo; row<=rowHi; )
+	{
+		// the rows of the range inside this block
+		const size_t end = std::min( rowHi, (row / Tile +1) * Tile -1 );
+		const Index b = find_block( row, col );
+
+		if( b == none() )
+		{
+			std::fill( out, out + (end - row +1), defaultValue );
+		}
+		else
+		{
+			const T* p = block( b ) + offset( row, col );
+			for( size_t r=row; r<=end; ++r, p += Tile )
+				out[r - row] = *p;
+		}
+
+		out += end - row +1;
+		if( end == std::numeric_limits<size_t>::max() ) break;
+		row = end +1;
+	}
+}
+
+template <typename T, typename Index, size_t Tile>
+template <typename F>
+void TiledOffsetMatrix<T, Index, Tile>::for_each_in( size_t rowLo, size_t rowHi, size_t colLo, size_t colHi, F fn ) const
+{
+	if( index.empty() || rowLo > rowHi || colLo > colHi ) return;
+
+	const size_t firstRow = std::max( rowLo / Tile, index.min() );
+	const size_t lastRow = std::min( rowHi / Tile, index.max() );
+
+	for( size_t br=firstRow; br<=lastRow; ++br )
+	{
+		const typename OffsetMatrix<Index>::Row &blockRow = index.get_row( br );
+		if( blockRow.empty() ) continue;
+
+		const size_t firstCol = std::max( colLo / Tile, blockRow.min() );
+		const size_t lastCol = std::min( colHi / Tile, blockRow.max() );
+
+		for( size_t bc=firstCol; bc<=lastCol; ++bc )
+		{
+			const Index b = blockRow.get( bc, none() );
+			if( b == none() ) continue;
+
+			// the part of the block inside the window
+			const size_t r0 = std::max( rowLo, br * Tile ), r1 = std::min( rowHi, br * Tile + Tile -1 );
+			const size_t c0 = std::max( colLo, bc * Tile ), c1 = std::min( colHi, bc * Tile + Tile -1 );
+
+			for( size_t r=r0; r<=r1; ++r )
+			{
+				const T* p = block( b ) + offset( r, c0 );
+				for( size_t c=c0; c<=c1; ++c )
+					fn( r, c, *p++ );
+			}
+		}
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include <cxxtest/TestSuite.h>
+#include <cstdint>
+#include <random>
+#include "offsetmatrix.h"
+#include "tiledoffsetmatrix.h"
+
+using namespace offset;
+
+class TiledOffsetMatrixTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+	/* a dense box with a few values scattered around it */
+	template <typename Matrix>
+	void fill( Matrix &store )
+	{
+		for( size_t row=100; row<300; ++row )
+			for( size_t col=1000; col<1100; ++col )
+				store.set( row, col, (int)(row*10000 + col) );
+
+		std::mt19937 rng( 42 );
+		for( size_t i=0; i<200; ++i )
+			store.set( rng() % 1000, rng() % 5000, (int)i );
+	}
+
+public:
+	void setUp()
+	{
+		defaultValue = -1;
+	}
+
+	void test_empty()
+	{
+		TiledOffsetMatrix<int> store( defaultValue );
+		TS_ASSERT( store.empty() );
+		TS_ASSERT_EQUALS( store.get( 5, 5 ), defaultValue );
+
+		// nothing stored for the default
+		store.set( 5, 5, defaultValue );
+		TS_ASSERT( store.empty() );
+
+		store.set( 5, 5, 1 );
+		TS_ASSERT_EQUALS( store.blocks(), 1 );
+		TS_ASSERT_EQUALS( store.values(), 64 * 64 );
+		TS_ASSERT_EQUALS( store.get( 5, 5 ), 1 );
+		TS_ASSERT_EQUALS( store.get( 5, 6 ), defaultValue );
+		TS_ASSERT_EQUALS( store.row_min(), 0 );
+		TS_ASSERT_EQUALS( store.row_max(), 63 );
+		TS_ASSERT_EQUALS( store.col_max(), 63 );
+
+		store.clear();
+		TS_ASSERT( store.empty() );
+		TS_ASSERT_EQUALS( store.get( 5, 5 ), defaultValue );
+	}
+
+	void test_get_set()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		TiledOffsetMatrix<int> store( defaultValue );
+		TiledOffsetMatrix<int, uint32_t, 16> small( defaultValue );
+		fill( expected );
+		fill( store );
+		fill( small );
+
+		for( size_t row=0; row<1000; ++row )
+			for( size_t col=0; col<5000; col+=7 )
+			{
+				TS_ASSERT_EQUALS( store.get( row, col ), expected.get( row, col ) );
+				TS_ASSERT_EQUALS( small( row, col ), expected.get( row, col ) );
+			}
+
+		// the box fills its blocks, 4 block rows by 3 block columns of it
+		TS_ASSERT( store.blocks() >= 4 * 3 );
+		TS_ASSERT( store.row_min() <= 100 && store.row_max() >= 299 );
+		TS_ASSERT( store.col_min() <= 1000 && store.col_max() >= 1099 );
+		TS_ASSERT( store.memory() >= sizeof(int) * store.values() );
+	}
+
+	void test_get_column()
+	{
+		TiledOffsetMatrix<int, uint32_t> store( defaultValue );
+		fill( store );
+
+		std::vector<int> column( 500 );
+		store.get_column( 1050, 50, 549, column.data() );
+		for( size_t row=50; row<550; ++row )
+			TS_ASSERT_EQUALS( column[row - 50], store.get( row, 1050 ) );
+
+		TS_ASSERT_EQUALS( column[ 100 - 50 ], 1001050 );
+		TS_ASSERT_EQUALS( column[ 299 - 50 ], 2991050 );
+
+		// a column with no blocks at all
+		store.get_column( 100000, 0, 9, column.data() );
+		TS_ASSERT_EQUALS( std::count( column.begin(), column.begin() + 10, defaultValue ), 10 );
+	}
+
+	void test_for_each_in()
+	{
+		OffsetMatrix<int> expected( defaultValue );
+		TiledOffsetMatrix<int> store( defaultValue );
+		fill( expected );
+		fill( store );
+
+		// a neighbourhood across a block corner
+		size_t cells = 0;
+		bool inside = true, same = true;
+		store.for_each_in( 120, 130, 1020, 1030, [&]( size_t row, size_t col, int value )
+		{
+			++cells;
+			inside &= row >= 120 && row <= 130 && col >= 1020 && col <= 1030;
+			same &= value == expected.get( row, col );
+		} );
+		TS_ASSERT_EQUALS( cells, 11 * 11 );
+		TS_ASSERT( inside );
+		TS_ASSERT( same );
+
+		// every stored value is visited once
+		size_t stored = 0;
+		store.for_each_in( 0, 2000, 0, 10000, [&]( size_t, size_t, int value )
+		{
+			stored += value != defaultValue;
+		} );
+		TS_ASSERT_EQUALS( stored, expected.count_not_default() );
+
+		cells = 0;
+		store.for_each_in( 5000, 6000, 0, 10, [&]( size_t, size_t, int ) { ++cells; } );
+		TS_ASSERT_EQUALS( cells, 0 );
+	}
+
+	void test_index_full()
+	{
+		// one cell per block, block numbers 0 to 254, 255 is none()
+		TiledOffsetMatrix<int, uint8_t, 1> store( defaultValue );
+
+		size_t failed = 0;
+		for( size_t col=0; col<300; ++col )
+			failed += store.set( 0, col, (int)col );
+		TS_ASSERT_EQUALS( failed, 300 - 255 );
+		TS_ASSERT_EQUALS( store.blocks(), 255 );
+
+		// the blocks that were made keep their values, the rest read as default
+		for( size_t col=0; col<255; ++col )
+			TS_ASSERT_EQUALS( store.get( 0, col ), (int)col );
+		for( size_t col=255; col<300; ++col )
+			TS_ASSERT_EQUALS( store.get( 0, col ), defaultValue );
+
+		// existing blocks can still be changed, the default never needs a block
+		TS_ASSERT( !store.set( 0, 0, 7 ) );
+		TS_ASSERT_EQUALS( store.get( 0, 0 ), 7 );
+		TS_ASSERT( !store.set( 0, 299, defaultValue ) );
+		TS_ASSERT( store.set( 1, 0, 1 ) );
+
+		store.clear();
+		TS_ASSERT( !store.set( 0, 299, 1 ) );
+		TS_ASSERT_EQUALS( store.get( 0, 299 ), 1 );
+	}
+};
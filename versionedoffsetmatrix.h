@@ -0,0 +1,259 @@
+#ifndef VERSIONEDOFFSETMATRIX_H
+#define VERSIONEDOFFSETMATRIX_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "offsetbuffer.h"
+#include "offsetmatrix.h"
+#include "offsetvector.h"
+
+namespace offset
+{
+
+/* OffsetMatrix with copy on write snapshots for one writer and any number
+	of readers.
+
+	the writer set()s values and publish()es a new version when it is
+	ready. readers take the latest version with snapshot() and can keep
+	reading it for as long as they like, without locks and unaffected by
+	later changes. every version shares the rows it has in common with the
+	one before through reference counted row buffers, a row is only copied
+	the first time set() touches it after a publish(), so keeping an old
+	version alive costs the touched rows rather than a second matrix.
+
+	set() and publish() must be called from one thread at a time,
+	snapshot() and anything on a Snapshot from any thread */
+template <typename T>
+class VersionedOffsetMatrix
+{
+public:
+	typedef OffsetVector<T> Row;
+
+	/* one published version, never changes */
+	class Snapshot
+	{
+		friend class VersionedOffsetMatrix<T>;
+
+		size_t mn = 0;
+		std::vector< std::shared_ptr<const Row> > rows;  // nullptr for empty rows
+
+	public:
+		T defaultValue;
+
+		Snapshot( const T& defaultValue ) : defaultValue(defaultValue) {}
+
+		/* get the number of rows, the min/max row numbers from the matrix */
+		size_t min() const { return mn; }
+		size_t max() const { return mn + rows.size() -1; }
+		size_t size() const { return rows.size(); }
+		bool empty() const { return rows.empty(); }
+		size_t values() const;
+
+		/* no bounds checking,
+			only use if row >= min() && row <= max() && !empty().
+			returns nullptr for a row with nothing in it */
+		const Row* get_row( size_t row ) const { return rows[row - mn].get(); }
+
+		/* returns the value at row, col,
+			if row, col doesn't exist then will return defaultValue */
+		T get( size_t row, size_t col ) const;
+		T operator()( size_t row, size_t col ) const { return get( row, col ); }
+	};
+
+private:
+	/* a row of the version being written, owned is false while the row is
+		still shared with the published version */
+	struct Slot
+	{
+		std::shared_ptr<Row> row;
+		bool owned = false;
+	};
+
+	size_t mn = 0;
+	OffsetBuffer<Slot> rows;
+	size_t copied = 0;
+
+	std::shared_ptr<const Snapshot> current;
+
+	Slot& get_slot( size_t row );
+
+public:
+	T defaultValue;
+
+	VersionedOffsetMatrix( const T& defaultValue );
+
+	/* start from the rows of matrix, without copying them */
+	explicit VersionedOffsetMatrix( OffsetMatrix<T>&& matrix );
+
+	VersionedOffsetMatrix( const VersionedOffsetMatrix<T>& other ) = delete;
+	VersionedOffsetMatrix<T>& operator=( const VersionedOffsetMatrix<T>& other ) = delete;
+
+	/* the version being written */
+	size_t min() const { return mn; }
+	size_t max() const { return mn + rows.size() -1; }
+	bool empty() const { return rows.empty(); }
+
+	/* set the value at row, col in the version being written,
+		copies the row first if it is shared with the published version */
+	void set( size_t row, size_t col, const T& val );
+
+	/* returns the value at row, col in the version being written */
+	T get( size_t row, size_t col ) const;
+
+	/* make the version being written the one snapshot() hands out,
+		every row is shared with it until it is next set() */
+	void publish();
+
+	/* the latest published version, empty until the first publish() */
+	std::shared_ptr<const Snapshot> snapshot() const { return std::atomic_load( &current ); }
+
+	/* make rows of the version being written with the same min() and
+		values share one row buffer, as rows shared with a published
+		version are. set() copies a shared row before changing it.
+		returns the number of rows that gave up their own buffer */
+	size_t dedup();
+
+	/* number of rows copied by set() since the matrix was created */
+	size_t rows_copied() const { return copied; }
+};
+
+template <typename T>
+size_t VersionedOffsetMatrix<T>::Snapshot::values() const
+{
+	size_t count = 0;
+	for( const std::shared_ptr<const Row> &r : rows )
+		if( r ) count += r->size();
+
+	return count;
+}
+
+template <typename T>
+T VersionedOffsetMatrix<T>::Snapshot::get( size_t row, size_t col ) const
+{
+	// row < min() wraps around, so one comparison covers both ends
+	const size_t i = row - mn;
+	if( i >= rows.size() || !rows[i] ) return defaultValue;
+
+	return rows[i]->get( col, defaultValue );
+}
+
+template <typename T>
+VersionedOffsetMatrix<T>::VersionedOffsetMatrix( const T& defaultValue ) :
+	current( std::make_shared<Snapshot>( defaultValue ) ), defaultValue(defaultValue) {}
+
+template <typename T>
+VersionedOffsetMatrix<T>::VersionedOffsetMatrix( OffsetMatrix<T>&& matrix ) :
+	VersionedOffsetMatrix( matrix.defaultValue )
+{
+	if( matrix.empty() ) return;
+
+	mn = matrix.min();
+	rows.resize( matrix.size() );
+	for( size_t i=0; i<matrix.size(); ++i )
+	{
+		Row &r = matrix.get_row( mn + i );
+		if( r.empty() ) continue;
+
+		rows[i].row = std::make_shared<Row>( std::move( r ) );
+		rows[i].owned = true;
+	}
+
+	matrix.clear();
+}
+
+template <typename T>
+typename VersionedOffsetMatrix<T>::Slot& VersionedOffsetMatrix<T>::get_slot( size_t row )
+{
+	if( rows.empty() )
+	{
+		rows.resize( 1 );
+		mn = row;
+	}
+	else if( row > max() )
+	{
+		rows.resize( row - mn +1 );
+	}
+	else if( row < mn )
+	{
+		rows.grow_front( mn - row, Slot() );
+		mn = row;
+	}
+
+	return rows[row - mn];
+}
+
+template <typename T>
+void VersionedOffsetMatrix<T>::set( size_t row, size_t col, const T& val )
+{
+	/* if val is the default value then don't both actually saving anything,
+		unless it overwrites a value already stored */
+	if( val == defaultValue )
+	{
+		const size_t i = row - mn;
+		if( i >= rows.size() || !rows[i].row || !rows[i].row->is_in( col ) ) return;
+	}
+
+	Slot &s = get_slot( row );
+	if( !s.owned )
+	{
+		s.row = s.row ? std::make_shared<Row>( *s.row ) : std::make_shared<Row>( defaultValue );
+		s.owned = true;
+		++copied;
+	}
+
+	s.row->set( col, val, defaultValue );
+}
+
+template <typename T>
+T VersionedOffsetMatrix<T>::get( size_t row, size_t col ) const
+{
+	const size_t i = row - mn;
+	if( i >= rows.size() || !rows[i].row ) return defaultValue;
+
+	return rows[i].row->get( col, defaultValue );
+}
+
+template <typename T>
+size_t VersionedOffsetMatrix<T>::dedup()
+{
+	const std::vector<size_t> first = format::find_duplicates<T>( rows.size(),
+		[this]( size_t i ) { return rows[i].row.get(); } );
+
+	size_t shared = 0;
+	for( size_t i=0; i<rows.size(); ++i )
+	{
+		if( first[i] == i ) continue;
+
+		Slot &original = rows[ first[i] ];
+		if( rows[i].row == original.row ) continue;
+
+		original.owned = false;
+		rows[i].row = original.row;
+		rows[i].owned = false;
+		++shared;
+	}
+
+	return shared;
+}
+
+template <typename T>
+void VersionedOffsetMatrix<T>::publish()
+{
+	std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>( defaultValue );
+	next->mn = mn;
+	next->rows.reserve( rows.size() );
+
+	for( Slot &s : rows )
+	{
+		next->rows.push_back( s.row );
+		s.owned = false;
+	}
+
+	std::atomic_store( &current, std::shared_ptr<const Snapshot>( std::move( next ) ) );
+}
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include <cxxtest/TestSuite.h>
+#include <thread>
+#include "offsettest.h"
+#include "versionedoffsetmatrix.h"
+
+using namespace offset;
+
+class VersionedOffsetMatrixTest: public CxxTest::TestSuite
+{
+private:
+	int defaultValue;
+
+public:
+	void setUp()
+	{
+		defaultValue = 999;
+	}
+
+	void test_empty()
+	{
+		VersionedOffsetMatrix<int> store( defaultValue );
+
+		std::shared_ptr<const VersionedOffsetMatrix<int>::Snapshot> snap = store.snapshot();
+		TS_ASSERT( snap->empty() );
+		TS_ASSERT_EQUALS( snap->get( 0, 0 ), defaultValue );
+
+		store.set( 3, 3, defaultValue );
+		TS_ASSERT( store.empty() );
+	}
+
+	void test_publish()
+	{
+		VersionedOffsetMatrix<int> store( defaultValue );
+		test::fill( store );
+
+		// nothing is visible until it is published
+		TS_ASSERT( store.snapshot()->empty() );
+		TS_ASSERT_EQUALS( store.get( 15, 20 ), 1520 );
+
+		store.publish();
+		auto first = store.snapshot();
+		TS_ASSERT_EQUALS( first->min(), 10 );
+		TS_ASSERT_EQUALS( first->max(), 19 );
+		TS_ASSERT_EQUALS( first->values(), 145 );
+		TS_ASSERT_EQUALS( first->get( 15, 20 ), 1520 );
+
+		// change one row and add another, the old version doesn't move
+		const size_t copied = store.rows_copied();
+		store.set( 15, 20, 1 );
+		store.set( 15, 21, 2 );
+		store.set( 5, 0, 3 );
+		TS_ASSERT_EQUALS( store.rows_copied(), copied +2 );
+		TS_ASSERT_EQUALS( first->get( 15, 20 ), 1520 );
+		TS_ASSERT_EQUALS( first->get( 5, 0 ), defaultValue );
+
+		store.publish();
+		auto second = store.snapshot();
+		TS_ASSERT_EQUALS( second->min(), 5 );
+		TS_ASSERT_EQUALS( second->get( 15, 20 ), 1 );
+		TS_ASSERT_EQUALS( second->get( 15, 21 ), 2 );
+		TS_ASSERT_EQUALS( second->get( 5, 0 ), 3 );
+		TS_ASSERT_EQUALS( second->get( 7, 0 ), defaultValue );
+
+		// untouched rows are shared, the touched one isn't
+		TS_ASSERT_EQUALS( first->get_row( 12 ), second->get_row( 12 ) );
+		TS_ASSERT_DIFFERS( first->get_row( 15 ), second->get_row( 15 ) );
+		TS_ASSERT( !second->get_row( 7 ) );
+	}
+
+	void test_from_matrix()
+	{
+		OffsetMatrix<int> m( defaultValue );
+		test::fill( m );
+
+		VersionedOffsetMatrix<int> store( std::move( m ) );
+		TS_ASSERT( m.empty() );
+		TS_ASSERT_EQUALS( store.get( 19, 37 ), 1937 );
+
+		// rows taken from the matrix are owned, nothing needs copying
+		store.set( 19, 37, 1 );
+		TS_ASSERT_EQUALS( store.rows_copied(), 0 );
+
+		store.publish();
+		TS_ASSERT_EQUALS( store.snapshot()->get( 19, 37 ), 1 );
+	}
+
+	void test_dedup()
+	{
+		VersionedOffsetMatrix<int> store( defaultValue );
+		for( size_t row=0; row<10; ++row )
+			for( size_t col=5; col<10; ++col )
+				store.set( row, col, (int)((row % 2) * 100 + col) );
+		store.set( 9, 20, 1 );
+
+		// 0 2 4 6 8 share one row, 1 3 5 7 another
+		TS_ASSERT_EQUALS( store.dedup(), 4 + 3 );
+		TS_ASSERT_EQUALS( store.dedup(), 0 );
+
+		store.publish();
+		std::shared_ptr<const VersionedOffsetMatrix<int>::Snapshot> snap = store.snapshot();
+		TS_ASSERT_EQUALS( snap->get_row( 0 ), snap->get_row( 8 ) );
+		TS_ASSERT_EQUALS( snap->get_row( 1 ), snap->get_row( 7 ) );
+		TS_ASSERT_DIFFERS( snap->get_row( 7 ), snap->get_row( 9 ) );
+
+		// changing one copies it, the others keep the shared row
+		const size_t copied = store.rows_copied();
+		store.set( 4, 6, 1 );
+		TS_ASSERT_EQUALS( store.rows_copied(), copied + 1 );
+		TS_ASSERT_EQUALS( store.get( 4, 6 ), 1 );
+		TS_ASSERT_EQUALS( store.get( 2, 6 ), 6 );
+		TS_ASSERT_EQUALS( snap->get( 4, 6 ), 6 );
+
+		// before a publish() the original is copied too
+		VersionedOffsetMatrix<int> other( defaultValue );
+		other.set( 0, 0, 1 );
+		other.set( 1, 0, 1 );
+		TS_ASSERT_EQUALS( other.dedup(), 1 );
+		other.set( 0, 0, 2 );
+		TS_ASSERT_EQUALS( other.get( 0, 0 ), 2 );
+		TS_ASSERT_EQUALS( other.get( 1, 0 ), 1 );
+	}
+
+	void test_readers()
+	{
+		VersionedOffsetMatrix<int> store( defaultValue );
+		std::atomic<bool> done( false );
+		std::atomic<size_t> bad( 0 );
+
+		// every version has the same value across the whole of row 0
+		std::vector<std::thread> readers;
+		for( size_t t=0; t<4; ++t )
+			readers.emplace_back( [&]()
+			{
+				while( !done )
+				{
+					auto snap = store.snapshot();
+					const int first = snap->get( 0, 0 );
+					for( size_t col=0; col<100; ++col )
+						if( snap->get( 0, col ) != first ) ++bad;
+				}
+			} );
+
+		for( int version=0; version<200; ++version )
+		{
+			for( size_t col=0; col<100; ++col )
+				store.set( 0, col, version );
+			store.set( 1 + version % 10, 0, version );
+			store.publish();
+		}
+
+		done = true;
+		for( std::thread &r : readers )
+			r.join();
+
+		TS_ASSERT_EQUALS( bad.load(), 0 );
+		TS_ASSERT_EQUALS( store.snapshot()->get( 0, 50 ), 199 );
+	}
+};